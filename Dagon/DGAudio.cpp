@@ -70,10 +70,28 @@ bool DGAudio::isPlaying() {
 // Implementation - Gets
 ////////////////////////////////////////////////////////////
 
+void DGAudio::appendFiles(vector<string> &arrayOfFiles) {
+    if (strstr(_resource.name, ".ogg"))
+        arrayOfFiles.push_back(config->path(DGPathRes, _resource.name, DGObjectAudio));
+    else {
+        // Any of them may be chosen when loaded
+        for (int i = 0; i < DGAudioRandomFiles; i++) {
+            char fileName[DGMaxFileLength];
+            
+            _sequencedFile(_resource.name, i, fileName);
+            arrayOfFiles.push_back(config->path(DGPathRes, fileName, DGObjectAudio));
+        }
+    }
+}
+
 double DGAudio::cursor() {
     return ov_time_tell(&_oggStream);
 }
 
+const char* DGAudio::resource() {
+    return _resource.name;
+}
+
 int DGAudio::state() {
     return _state;
 }
@@ -308,15 +326,19 @@ const char* DGAudio::_randomizeFile(const char* fileName) {
     }
     else { // Randomize
         static char fileToLoad[DGMaxFileLength];
-        int index = (rand() % 6); // Allow to configure
+        int index = (rand() % DGAudioRandomFiles); // Allow to configure
         
-        snprintf(fileToLoad, DGMaxFileLength, "%s%0" in_between(DGFileSeqDigits) "d.%s", fileName,
-                 index + DGFileSeqStart, "ogg");
+        _sequencedFile(fileName, index, fileToLoad);
         
         return fileToLoad;
     }
 }
 
+void DGAudio::_sequencedFile(const char* fileName, int index, char* fileToLoad) {
+    snprintf(fileToLoad, DGMaxFileLength, "%s%0" in_between(DGFileSeqDigits) "d.%s", fileName,
+             index + DGFileSeqStart, "ogg");
+}
+
 bool DGAudio::_stream(ALuint* buffer) {
     // This is a failsafe; if this is true, we won't attempt
     // to stream anymore
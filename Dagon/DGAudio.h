@@ -43,6 +43,7 @@
 ////////////////////////////////////////////////////////////
 
 #define DGAudioNumberOfBuffers  2
+#define DGAudioRandomFiles      6 // Chosen from when no extension is given
 
 enum DGAudioFlags {
     DGAudioFadeIn,
@@ -102,6 +103,7 @@ class DGAudio : public DGObject {
     // We use this one to periodically check for errors
     void _emptyBuffers();
     const char* _randomizeFile(const char* fileName);    
+    void _sequencedFile(const char* fileName, int index, char* fileToLoad);
     ALboolean _verifyError(const char* operation);
     
     // Callbacks for Vorbisfile library
@@ -122,7 +124,9 @@ public:
     
     // Gets
     
+    void appendFiles(std::vector<std::string> &arrayOfFiles); // Any it may load, with their path
     double cursor(); // For match function
+    const char* resource();
     int state();
     
     // Sets
@@ -0,0 +1,1191 @@
+////////////////////////////////////////////////////////////
+//
+// DAGON - An Adventure Game Engine
+// Copyright (c) 2011 Senscape s.r.l.
+// All rights reserved.
+//
+// NOTICE: Senscape permits you to use, modify, and
+// distribute this file in accordance with the terms of the
+// license agreement accompanying it.
+//
+////////////////////////////////////////////////////////////
+
+// Offline baker for TEX bundles. It reads the image sequences of the
+// nodes (name + index, as expected by the Texture Manager), encodes
+// every face to S3TC with a full chain of mipmaps and writes version 2
+// bundles ready to be uploaded. No GL context is required.
+//
+// With -t, faces are split in tiles of the given size, and smaller copies
+// of them are tiled as well until a single tile covers the face. Such
+// bundles are streamed by the Texture Manager as the player looks around.
+//
+// With -p, every payload is packed as well with zlib or LZ4, which mostly
+// helps when reading from slow disks. See TEXChunk.
+//
+// With -u, faces are stored as plain RGBA instead of S3TC, which keeps
+// them lossless at the cost of size. Packing them pays off the most.
+//
+// With -a, the small images of the folder are packed instead into the
+// atlas pages the Texture Manager looks for when loading interface
+// images.
+//
+// Usage: dagon-bake [-a] [-j threads] [-p zlib|lz4] [-t tile size] [-u] <input folder> [output folder]
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Only what the bundles share with the engine, which needs no GL
+#include "DGDefines.h"
+#include "DGLanguage.h"
+#include "DGTextureFormat.h"
+#include "stb_image.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////
+
+#define DGBakeBlockSize     4
+#define DGBakeHashSize      65536
+#define DGBakeMaxChain      64 // Matches tried at each position when deflating
+#define DGBakeMaxThreads    64
+#define DGBakeMinTileSize   64
+#define DGBakeWindowSize    32768
+
+typedef struct {
+    uint32_t position; // See TEXTilePosition
+    uint32_t width;
+    uint32_t height;
+    uint32_t numLevels;
+    uint32_t levelSize[TEXMaxLevels];
+    vector<unsigned char> data;
+} DGBakeTile;
+
+typedef struct {
+    string fileName;
+    int index; // Position in the bundle
+
+    // Filled by the workers
+    uint32_t channels;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t numLevels;
+    uint32_t levelSize[TEXMaxLevels];
+    vector<unsigned char> data;
+    vector<DGBakeTile> arrayOfTiles; // Instead of the data if split
+    bool isDone;
+} DGBakeFace;
+
+typedef struct {
+    string name;
+    vector<DGBakeFace> arrayOfFaces;
+} DGBakeBundle;
+
+typedef struct {
+    string fileName;
+    int width;
+    int height;
+    unsigned char* pixels;
+    int original; // An identical image listed before, or -1
+
+    // Position in the atlas, border included
+    int page;
+    int x;
+    int y;
+} DGBakeImage;
+
+// Bits are written in the order deflate reads them, from the least significant
+typedef struct {
+    vector<unsigned char>* output;
+    uint32_t buffer;
+    int count;
+} DGBakeBits;
+
+// Shared by all the workers
+vector<DGBakeFace*> arrayOfJobs;
+unsigned int nextJob = 0;
+pthread_mutex_t jobsMutex = PTHREAD_MUTEX_INITIALIZER;
+int packCodec = -1; // Payloads aren't packed unless set
+long sharedBytes = 0; // Not written since the payload was already in the bundle
+int tileSize = 0; // Faces aren't split unless set
+bool isUncompressed = false; // Faces are encoded to S3TC unless set
+
+////////////////////////////////////////////////////////////
+// Implementation - S3TC encoding
+////////////////////////////////////////////////////////////
+
+static inline int _clamp(int value, int low, int high) {
+    return (value < low) ? low : ((value > high) ? high : value);
+}
+
+static inline uint16_t _pack565(const int* rgb) {
+    return (uint16_t)(((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3));
+}
+
+static inline void _unpack565(uint16_t color, int* rgb) {
+    rgb[0] = ((color >> 11) & 0x1f) << 3 | ((color >> 13) & 0x07);
+    rgb[1] = ((color >> 5) & 0x3f) << 2 | ((color >> 9) & 0x03);
+    rgb[2] = (color & 0x1f) << 3 | ((color >> 2) & 0x07);
+}
+
+// The endpoints are taken from the bounding box of the block, slightly
+// inset to reduce the error, and always in four color mode
+static void _encodeColorBlock(const unsigned char* block, unsigned char* output) {
+    int min[3] = {255, 255, 255};
+    int max[3] = {0, 0, 0};
+    int palette[4][3];
+    uint16_t color0, color1;
+    uint32_t indices = 0;
+
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (block[i * 4 + c] < min[c]) min[c] = block[i * 4 + c];
+            if (block[i * 4 + c] > max[c]) max[c] = block[i * 4 + c];
+        }
+    }
+
+    for (int c = 0; c < 3; c++) {
+        int inset = (max[c] - min[c]) >> 4;
+
+        min[c] = _clamp(min[c] + inset, 0, 255);
+        max[c] = _clamp(max[c] - inset, 0, 255);
+    }
+
+    color0 = _pack565(max);
+    color1 = _pack565(min);
+
+    if (color0 < color1) {
+        uint16_t swap = color0;
+
+        color0 = color1;
+        color1 = swap;
+    }
+
+    _unpack565(color0, palette[0]);
+    _unpack565(color1, palette[1]);
+
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    // With equal endpoints every index would pick the same color
+    if (color0 != color1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestError = INT32_MAX;
+
+            for (int p = 0; p < 4; p++) {
+                int error = 0;
+
+                for (int c = 0; c < 3; c++) {
+                    int delta = block[i * 4 + c] - palette[p][c];
+                    error += delta * delta;
+                }
+
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    output[0] = color0 & 0xff;
+    output[1] = color0 >> 8;
+    output[2] = color1 & 0xff;
+    output[3] = color1 >> 8;
+    output[4] = indices & 0xff;
+    output[5] = (indices >> 8) & 0xff;
+    output[6] = (indices >> 16) & 0xff;
+    output[7] = (indices >> 24) & 0xff;
+}
+
+// Eight alpha values interpolated between the extremes of the block
+static void _encodeAlphaBlock(const unsigned char* block, unsigned char* output) {
+    int alpha0 = 0;
+    int alpha1 = 255;
+    int palette[8];
+    uint64_t indices = 0;
+
+    for (int i = 0; i < 16; i++) {
+        if (block[i * 4 + 3] > alpha0) alpha0 = block[i * 4 + 3];
+        if (block[i * 4 + 3] < alpha1) alpha1 = block[i * 4 + 3];
+    }
+
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+
+    for (int p = 1; p < 7; p++)
+        palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+
+    if (alpha0 != alpha1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestError = 256;
+
+            for (int p = 0; p < 8; p++) {
+                int error = abs(block[i * 4 + 3] - palette[p]);
+
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+
+    output[0] = (unsigned char)alpha0;
+    output[1] = (unsigned char)alpha1;
+
+    for (int i = 0; i < 6; i++)
+        output[i + 2] = (indices >> (i * 8)) & 0xff;
+}
+
+// Expects RGBA pixels and appends the encoded level to the output
+static void _encodeLevel(const unsigned char* pixels, int width, int height,
+                         bool hasAlpha, vector<unsigned char> &output) {
+    unsigned char block[16 * 4];
+
+    // Rows of four bytes per pixel need no unpack alignment
+    if (isUncompressed) {
+        output.insert(output.end(), pixels, pixels + (width * height * 4));
+        return;
+    }
+
+    for (int y = 0; y < height; y += DGBakeBlockSize) {
+        for (int x = 0; x < width; x += DGBakeBlockSize) {
+            unsigned char encoded[16];
+
+            // Blocks in the edges repeat the last row and column
+            for (int by = 0; by < DGBakeBlockSize; by++) {
+                for (int bx = 0; bx < DGBakeBlockSize; bx++) {
+                    int px = min(x + bx, width - 1);
+                    int py = min(y + by, height - 1);
+
+                    memcpy(&block[(by * DGBakeBlockSize + bx) * 4], &pixels[(py * width + px) * 4], 4);
+                }
+            }
+
+            if (hasAlpha) {
+                _encodeAlphaBlock(block, encoded);
+                _encodeColorBlock(block, encoded + 8);
+                output.insert(output.end(), encoded, encoded + 16);
+            }
+            else {
+                _encodeColorBlock(block, encoded);
+                output.insert(output.end(), encoded, encoded + 8);
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Packing
+////////////////////////////////////////////////////////////
+
+static const int _lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int _lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int _distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                    8193, 12289, 16385, 24577};
+static const int _distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                     7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static inline uint32_t _hash(const unsigned char* data, int length) {
+    uint32_t value = 0;
+
+    for (int i = 0; i < length; i++)
+        value = (value << 8) | data[i];
+
+    return (value * 2654435761u) >> 16;
+}
+
+static void _putBits(DGBakeBits* bits, uint32_t value, int count) {
+    bits->buffer |= value << bits->count;
+    bits->count += count;
+
+    while (bits->count >= 8) {
+        bits->output->push_back((unsigned char)(bits->buffer & 0xff));
+        bits->buffer >>= 8;
+        bits->count -= 8;
+    }
+}
+
+// Huffman codes go from the most significant bit instead
+static void _putCode(DGBakeBits* bits, uint32_t code, int length) {
+    uint32_t reversed = 0;
+
+    for (int i = 0; i < length; i++)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+    _putBits(bits, reversed, length);
+}
+
+// With the fixed codes of deflate
+static void _putSymbol(DGBakeBits* bits, int symbol) {
+    if (symbol < 144)
+        _putCode(bits, 0x30 + symbol, 8);
+    else if (symbol < 256)
+        _putCode(bits, 0x190 + (symbol - 144), 9);
+    else if (symbol < 280)
+        _putCode(bits, symbol - 256, 7);
+    else
+        _putCode(bits, 0xc0 + (symbol - 280), 8);
+}
+
+// A zlib stream with a single block of fixed codes, which is enough for
+// S3TC data and keeps this simple
+static void _deflate(const unsigned char* data, uint32_t size, vector<unsigned char> &output) {
+    DGBakeBits bits = {&output, 0, 0};
+    vector<int> head(DGBakeHashSize, -1);
+    vector<int> previous(size, -1);
+    uint32_t checksum = TEXChecksum(data, size);
+    uint32_t position = 0;
+
+    // Default window, no dictionary
+    output.push_back(0x78);
+    output.push_back(0x01);
+
+    _putBits(&bits, 1, 1); // Final block
+    _putBits(&bits, 1, 2); // Fixed codes
+
+    while (position < size) {
+        int bestLength = 0;
+        int bestDistance = 0;
+
+        if ((position + 3) <= size) {
+            uint32_t hash = _hash(data + position, 3);
+            int candidate = head[hash];
+            int maxLength = (int)min(size - position, (uint32_t)258);
+
+            for (int chain = 0; (chain < DGBakeMaxChain) && (candidate >= 0) &&
+                 ((int)position - candidate <= DGBakeWindowSize); chain++) {
+                int length = 0;
+
+                while ((length < maxLength) && (data[candidate + length] == data[position + length]))
+                    length++;
+
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = (int)position - candidate;
+
+                    if (length == maxLength)
+                        break;
+                }
+
+                candidate = previous[candidate];
+            }
+
+            previous[position] = head[hash];
+            head[hash] = (int)position;
+        }
+
+        if (bestLength >= 3) {
+            int code = 0;
+
+            while ((code < 28) && (_lengthBase[code + 1] <= bestLength))
+                code++;
+
+            _putSymbol(&bits, 257 + code);
+            _putBits(&bits, bestLength - _lengthBase[code], _lengthExtra[code]);
+
+            code = 0;
+
+            while ((code < 29) && (_distanceBase[code + 1] <= bestDistance))
+                code++;
+
+            _putCode(&bits, code, 5);
+            _putBits(&bits, bestDistance - _distanceBase[code], _distanceExtra[code]);
+
+            // The positions covered by the match may be matched later
+            for (int i = 1; i < bestLength; i++) {
+                uint32_t next = position + i;
+
+                if ((next + 3) <= size) {
+                    uint32_t hash = _hash(data + next, 3);
+
+                    previous[next] = head[hash];
+                    head[hash] = (int)next;
+                }
+            }
+
+            position += bestLength;
+        }
+        else {
+            _putSymbol(&bits, data[position]);
+            position++;
+        }
+    }
+
+    _putSymbol(&bits, 256); // End of block
+
+    if (bits.count)
+        _putBits(&bits, 0, 8 - bits.count);
+
+    output.push_back((unsigned char)(checksum >> 24));
+    output.push_back((unsigned char)(checksum >> 16));
+    output.push_back((unsigned char)(checksum >> 8));
+    output.push_back((unsigned char)checksum);
+}
+
+static void _putLength(vector<unsigned char> &output, uint32_t length) {
+    while (length >= 255) {
+        output.push_back(255);
+        length -= 255;
+    }
+
+    output.push_back((unsigned char)length);
+}
+
+// A single LZ4 block. The format requires the last match to begin 12 bytes
+// before the end, and the last 5 bytes to be literals.
+static void _encodeLZ4(const unsigned char* data, uint32_t size, vector<unsigned char> &output) {
+    vector<int> table(DGBakeHashSize, -1);
+    uint32_t anchor = 0, position = 0;
+    uint32_t limit = (size > 12) ? (size - 12) : 0;
+    uint32_t literals;
+
+    while (position < limit) {
+        uint32_t hash = _hash(data + position, 4);
+        int candidate = table[hash];
+
+        table[hash] = (int)position;
+
+        if ((candidate < 0) || ((position - candidate) > 65535) ||
+            (memcmp(data + candidate, data + position, 4) != 0)) {
+            position++;
+            continue;
+        }
+
+        uint32_t length = 4;
+        uint32_t offset = position - candidate;
+
+        while (((position + length) < (size - 5)) && (data[candidate + length] == data[position + length]))
+            length++;
+
+        literals = position - anchor;
+        output.push_back((unsigned char)((min(literals, (uint32_t)15) << 4) | min(length - 4, (uint32_t)15)));
+
+        if (literals >= 15)
+            _putLength(output, literals - 15);
+
+        output.insert(output.end(), data + anchor, data + position);
+        output.push_back((unsigned char)(offset & 0xff));
+        output.push_back((unsigned char)(offset >> 8));
+
+        if ((length - 4) >= 15)
+            _putLength(output, length - 4 - 15);
+
+        position += length;
+        anchor = position;
+    }
+
+    literals = size - anchor;
+    output.push_back((unsigned char)(min(literals, (uint32_t)15) << 4));
+
+    if (literals >= 15)
+        _putLength(output, literals - 15);
+
+    output.insert(output.end(), data + anchor, data + size);
+}
+
+// Replaces the payload with its chunks, each one stored as is if packing
+// doesn't make it smaller
+static void _pack(vector<unsigned char> &payload) {
+    vector<TEXChunk> arrayOfChunks;
+    vector<unsigned char> packedData, output;
+    uint32_t numChunks;
+
+    for (size_t offset = 0; offset < payload.size(); offset += TEXChunkSize) {
+        TEXChunk chunk;
+        vector<unsigned char> packed;
+
+        chunk.size = (uint32_t)min(payload.size() - offset, (size_t)TEXChunkSize);
+        chunk.checksum = TEXChecksum(&payload[offset], chunk.size);
+
+        if (packCodec == TEXCodecLZ4)
+            _encodeLZ4(&payload[offset], chunk.size, packed);
+        else
+            _deflate(&payload[offset], chunk.size, packed);
+
+        if (packed.size() < chunk.size) {
+            chunk.codec = packCodec;
+            packedData.insert(packedData.end(), packed.begin(), packed.end());
+        }
+        else {
+            chunk.codec = TEXCodecStored;
+            packed.assign(payload.begin() + offset, payload.begin() + offset + chunk.size);
+            packedData.insert(packedData.end(), packed.begin(), packed.end());
+        }
+
+        chunk.packedSize = (uint32_t)packed.size();
+        arrayOfChunks.push_back(chunk);
+    }
+
+    numChunks = (uint32_t)arrayOfChunks.size();
+
+    output.insert(output.end(), (unsigned char*)&numChunks, (unsigned char*)&numChunks + sizeof(numChunks));
+
+    if (numChunks)
+        output.insert(output.end(), (unsigned char*)&arrayOfChunks[0],
+                      (unsigned char*)&arrayOfChunks[0] + (numChunks * sizeof(TEXChunk)));
+
+    output.insert(output.end(), packedData.begin(), packedData.end());
+    payload.swap(output);
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Workers
+////////////////////////////////////////////////////////////
+
+// Box filter, odd sizes simply drop the last row or column
+static void _reduce(const unsigned char* source, int width, int height,
+                    unsigned char* target, int targetWidth, int targetHeight) {
+    for (int y = 0; y < targetHeight; y++) {
+        for (int x = 0; x < targetWidth; x++) {
+            int x0 = min(x * 2, width - 1), x1 = min(x * 2 + 1, width - 1);
+            int y0 = min(y * 2, height - 1), y1 = min(y * 2 + 1, height - 1);
+
+            for (int c = 0; c < 4; c++) {
+                int sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c] +
+                          source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+
+                target[(y * targetWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+// Encodes the image with all its mipmaps, leaving the pixels untouched
+static void _encodeChain(const unsigned char* pixels, int width, int height, bool hasAlpha,
+                         vector<unsigned char> &output, uint32_t* levelSize, uint32_t* numLevels) {
+    unsigned char* level = NULL;
+
+    *numLevels = 0;
+
+    // Encode each level and reduce the image for the next one
+    while (*numLevels < TEXMaxLevels) {
+        size_t previousSize = output.size();
+
+        _encodeLevel(level ? level : pixels, width, height, hasAlpha, output);
+        levelSize[(*numLevels)++] = (uint32_t)(output.size() - previousSize);
+
+        if ((width == 1) && (height == 1))
+            break;
+
+        int nextWidth = max(width / 2, 1);
+        int nextHeight = max(height / 2, 1);
+        unsigned char* reduced = (unsigned char*)malloc(nextWidth * nextHeight * 4);
+
+        _reduce(level ? level : pixels, width, height, reduced, nextWidth, nextHeight);
+        free(level);
+
+        level = reduced;
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    free(level);
+}
+
+// Cuts every level of the face in tiles, down to the one that fits in a
+// single tile. Each tile has its own mipmaps as well.
+static void _bakeTiles(DGBakeFace* face, const unsigned char* pixels, int width, int height, bool hasAlpha) {
+    unsigned char* level = NULL;
+    unsigned char* tilePixels = (unsigned char*)malloc(tileSize * tileSize * 4);
+
+    for (int index = 0; index < TEXMaxLevels; index++) {
+        const unsigned char* source = level ? level : pixels;
+
+        for (int y = 0; (y * tileSize) < height; y++) {
+            for (int x = 0; (x * tileSize) < width; x++) {
+                DGBakeTile tile;
+
+                tile.position = TEXTilePosition(face->index, index, x, y);
+                tile.width = min(tileSize, width - (x * tileSize));
+                tile.height = min(tileSize, height - (y * tileSize));
+
+                for (uint32_t row = 0; row < tile.height; row++)
+                    memcpy(&tilePixels[row * tile.width * 4],
+                           &source[(((y * tileSize) + row) * width + (x * tileSize)) * 4], tile.width * 4);
+
+                _encodeChain(tilePixels, tile.width, tile.height, hasAlpha, tile.data,
+                             tile.levelSize, &tile.numLevels);
+                face->arrayOfTiles.push_back(tile);
+            }
+        }
+
+        if ((width <= tileSize) && (height <= tileSize))
+            break;
+
+        int nextWidth = max(width / 2, 1);
+        int nextHeight = max(height / 2, 1);
+        unsigned char* reduced = (unsigned char*)malloc(nextWidth * nextHeight * 4);
+
+        _reduce(source, width, height, reduced, nextWidth, nextHeight);
+        free(level);
+
+        level = reduced;
+        width = nextWidth;
+        height = nextHeight;
+    }
+
+    free(level);
+    free(tilePixels);
+}
+
+static void _bakeFace(DGBakeFace* face) {
+    int width, height, comp;
+    unsigned char* pixels;
+    bool hasAlpha;
+
+    pixels = stbi_load(face->fileName.c_str(), &width, &height, &comp, STBI_rgb_alpha);
+
+    if (!pixels) {
+        fprintf(stderr, "%s: (%s) %s\n", DGMsg210001, face->fileName.c_str(), stbi_failure_reason());
+        return;
+    }
+
+    hasAlpha = (comp == STBI_grey_alpha) || (comp == STBI_rgb_alpha);
+
+    if (isUncompressed) {
+        face->channels = 4;
+        face->format = TEXFormatRGBA;
+    }
+    else {
+        face->channels = hasAlpha ? 4 : 3;
+        face->format = hasAlpha ? TEXFormatDXT5 : TEXFormatDXT1;
+    }
+    face->width = width;
+    face->height = height;
+
+    if (tileSize)
+        _bakeTiles(face, pixels, width, height, hasAlpha);
+    else
+        _encodeChain(pixels, width, height, hasAlpha, face->data, face->levelSize, &face->numLevels);
+
+    stbi_image_free(pixels);
+
+    if (packCodec >= 0) {
+        _pack(face->data);
+
+        for (unsigned int i = 0; i < face->arrayOfTiles.size(); i++)
+            _pack(face->arrayOfTiles[i].data);
+    }
+
+    face->isDone = true;
+}
+
+static void* _worker(void*) {
+    for (;;) {
+        DGBakeFace* face = NULL;
+
+        pthread_mutex_lock(&jobsMutex);
+        if (nextJob < arrayOfJobs.size())
+            face = arrayOfJobs[nextJob++];
+        pthread_mutex_unlock(&jobsMutex);
+
+        if (!face)
+            break;
+
+        _bakeFace(face);
+    }
+
+    return NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Bundles
+////////////////////////////////////////////////////////////
+
+static uint32_t _alignedOffset(uint32_t offset) {
+    return (offset + TEXAlignment - 1) & ~(TEXAlignment - 1);
+}
+
+// Collects the files named as a prefix followed by the index and an extension
+static void _scan(const char* folder, vector<DGBakeBundle> &arrayOfBundles) {
+    DIR* dir = opendir(folder);
+    struct dirent* entry;
+
+    if (!dir) {
+        fprintf(stderr, "%s: %s\n", DGMsg210000, folder);
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        string fileName = entry->d_name;
+        size_t dot = fileName.rfind('.');
+
+        if ((dot == string::npos) || (dot <= DGFileSeqDigits) || (fileName.substr(dot + 1) == DGDefTexExtension))
+            continue;
+
+        string digits = fileName.substr(dot - DGFileSeqDigits, DGFileSeqDigits);
+
+        if (digits.find_first_not_of("0123456789") != string::npos)
+            continue;
+
+        DGBakeFace face;
+        string name = fileName.substr(0, dot - DGFileSeqDigits);
+        vector<DGBakeBundle>::iterator it;
+
+        face.fileName = string(folder) + "/" + fileName;
+        face.index = atoi(digits.c_str()) - DGFileSeqStart;
+        face.numLevels = 0;
+        face.isDone = false;
+
+        for (it = arrayOfBundles.begin(); it != arrayOfBundles.end(); it++) {
+            if ((*it).name == name)
+                break;
+        }
+
+        if (it == arrayOfBundles.end()) {
+            DGBakeBundle bundle;
+
+            bundle.name = name;
+            arrayOfBundles.push_back(bundle);
+            it = arrayOfBundles.end() - 1;
+        }
+
+        (*it).arrayOfFaces.push_back(face);
+    }
+
+    closedir(dir);
+}
+
+static bool _faceSort(const DGBakeFace &f1, const DGBakeFace &f2) {
+    return f1.index < f2.index;
+}
+
+static bool _write(DGBakeBundle &bundle, const char* folder, int compressionLevel) {
+    TEXMainHeaderV2 header;
+    vector<TEXEntry> arrayOfEntries;
+    vector<vector<unsigned char>*> arrayOfPayloads;
+    vector<uint64_t> arrayOfHashes;
+    vector<int> arrayOfOriginals; // Entries with identical payloads point to the first one
+    char ident[8];
+    char fileName[DGMaxFileLength];
+    uint32_t offset;
+    FILE* fh;
+
+    memset(ident, 0, sizeof(ident));
+    memset(&header, 0, sizeof(header));
+
+    strncpy(ident, TEXIdentV2, sizeof(ident));
+    strncpy(header.name, bundle.name.c_str(), sizeof(header.name) - 1);
+    header.version = TEXVersion;
+    header.compressionLevel = compressionLevel;
+
+    // Tiles take the place of their face in the directory
+    for (unsigned int i = 0; i < bundle.arrayOfFaces.size(); i++) {
+        DGBakeFace &face = bundle.arrayOfFaces[i];
+        TEXEntry entry;
+
+        memset(&entry, 0, sizeof(entry));
+
+        entry.depth = face.channels;
+        entry.format = face.format;
+
+        if (face.arrayOfTiles.empty()) {
+            entry.cubePosition = face.index;
+            entry.width = face.width;
+            entry.height = face.height;
+            entry.numLevels = face.numLevels;
+            memcpy(entry.levelSize, face.levelSize, sizeof(entry.levelSize));
+
+            arrayOfEntries.push_back(entry);
+            arrayOfPayloads.push_back(&face.data);
+        }
+        else {
+            header.tileSize = tileSize;
+
+            for (unsigned int j = 0; j < face.arrayOfTiles.size(); j++) {
+                DGBakeTile &tile = face.arrayOfTiles[j];
+
+                entry.cubePosition = tile.position;
+                entry.width = tile.width;
+                entry.height = tile.height;
+                entry.numLevels = tile.numLevels;
+                memcpy(entry.levelSize, tile.levelSize, sizeof(entry.levelSize));
+
+                arrayOfEntries.push_back(entry);
+                arrayOfPayloads.push_back(&tile.data);
+            }
+        }
+    }
+
+    header.numTextures = (uint32_t)arrayOfEntries.size();
+
+    offset = sizeof(ident) + sizeof(header) + (header.numTextures * sizeof(TEXEntry));
+
+    for (unsigned int i = 0; i < arrayOfEntries.size(); i++) {
+        TEXEntry &entry = arrayOfEntries[i];
+        vector<unsigned char> &payload = *arrayOfPayloads[i];
+        int original = i;
+
+        arrayOfHashes.push_back(TEXHash(payload.empty() ? NULL : &payload[0], (long)payload.size(),
+                                        14695981039346656037ULL));
+
+        // Faces repeated across the bundle, like plain floors, are stored once
+        for (unsigned int j = 0; j < i; j++) {
+            TEXEntry &previous = arrayOfEntries[j];
+
+            if (!payload.empty() && (arrayOfOriginals[j] == (int)j) &&
+                (arrayOfHashes[j] == arrayOfHashes[i]) && (previous.width == entry.width) &&
+                (previous.height == entry.height) && (previous.format == entry.format) &&
+                (previous.numLevels == entry.numLevels) &&
+                (arrayOfPayloads[j]->size() == payload.size()) &&
+                !memcmp(&(*arrayOfPayloads[j])[0], &payload[0], payload.size())) {
+                original = j;
+                break;
+            }
+        }
+
+        arrayOfOriginals.push_back(original);
+        entry.size = (uint32_t)payload.size();
+
+        if (original != (int)i) {
+            entry.offset = arrayOfEntries[original].offset;
+            sharedBytes += entry.size;
+            continue;
+        }
+
+        entry.offset = _alignedOffset(offset);
+        offset = entry.offset + entry.size;
+    }
+
+    snprintf(fileName, DGMaxFileLength, "%s/%s.%s", folder, bundle.name.c_str(), DGDefTexExtension);
+
+    fh = fopen(fileName, "wb");
+
+    if (!fh) {
+        fprintf(stderr, "%s: %s\n", fileName, strerror(errno));
+        return false;
+    }
+
+    bool isWritten = (fwrite(ident, 1, sizeof(ident), fh) == sizeof(ident)) &&
+                     (fwrite(&header, 1, sizeof(header), fh) == sizeof(header)) &&
+                     (fwrite(&arrayOfEntries[0], sizeof(TEXEntry), arrayOfEntries.size(), fh) ==
+                      arrayOfEntries.size());
+
+    for (unsigned int i = 0; isWritten && (i < arrayOfEntries.size()); i++) {
+        if (arrayOfOriginals[i] != (int)i)
+            continue;
+
+        // Pad until the payload
+        while (isWritten && (ftell(fh) < (long)arrayOfEntries[i].offset))
+            isWritten = (fputc(0, fh) != EOF);
+
+        if (isWritten && !arrayOfPayloads[i]->empty())
+            isWritten = (fwrite(&(*arrayOfPayloads[i])[0], 1, arrayOfPayloads[i]->size(), fh) ==
+                         arrayOfPayloads[i]->size());
+    }
+
+    // Buffered data may only fail here, on a full disk for instance
+    if ((fclose(fh) != 0) || !isWritten) {
+        fprintf(stderr, "%s: %s\n", fileName, strerror(errno));
+
+        // The engine would reject a truncated bundle anyway
+        remove(fileName);
+
+        return false;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Atlas
+////////////////////////////////////////////////////////////
+
+static bool _imageSort(const DGBakeImage &i1, const DGBakeImage &i2) {
+    return i1.height > i2.height;
+}
+
+// Same shelf packing as the Texture Manager does at runtime, so that
+// both produce identical pages
+static bool _bakeAtlas(const char* inputFolder, const char* outputFolder) {
+    vector<DGBakeImage> arrayOfImages;
+    DGBakeBundle bundle;
+    DIR* dir = opendir(inputFolder);
+    struct dirent* entry;
+    int page = 0, shelfX = 0, shelfY = 0, shelfHeight = 0;
+    int numShared = 0;
+    char fileName[DGMaxFileLength];
+    FILE* fh;
+
+    if (!dir) {
+        fprintf(stderr, "%s: %s\n", DGMsg210000, inputFolder);
+        return false;
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        DGBakeImage image;
+        int comp;
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        image.fileName = entry->d_name;
+        image.original = -1;
+        image.pixels = stbi_load((string(inputFolder) + "/" + image.fileName).c_str(),
+                                 &image.width, &image.height, &comp, STBI_rgb_alpha);
+
+        if (!image.pixels)
+            continue;
+
+        // Bigger images keep a texture of their own
+        if ((image.width <= DGAtlasMaxImage) && (image.height <= DGAtlasMaxImage))
+            arrayOfImages.push_back(image);
+        else
+            stbi_image_free(image.pixels);
+    }
+
+    closedir(dir);
+
+    if (arrayOfImages.empty()) {
+        printf("No images to pack\n");
+        return true;
+    }
+
+    // Tallest first, so that the shelves waste less space
+    sort(arrayOfImages.begin(), arrayOfImages.end(), _imageSort);
+
+    // Copies of the same image under other names take its place
+    for (unsigned int i = 0; i < arrayOfImages.size(); i++) {
+        DGBakeImage &image = arrayOfImages[i];
+
+        for (unsigned int j = 0; j < i; j++) {
+            DGBakeImage &previous = arrayOfImages[j];
+
+            if ((previous.original < 0) && (previous.width == image.width) &&
+                (previous.height == image.height) &&
+                !memcmp(previous.pixels, image.pixels, image.width * image.height * 4)) {
+                image.original = j;
+                numShared++;
+                break;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < arrayOfImages.size(); i++) {
+        DGBakeImage &image = arrayOfImages[i];
+        int width = image.width + (DGAtlasBorder * 2);
+        int height = image.height + (DGAtlasBorder * 2);
+
+        if (image.original >= 0) {
+            image.page = arrayOfImages[image.original].page;
+            image.x = arrayOfImages[image.original].x;
+            image.y = arrayOfImages[image.original].y;
+            continue;
+        }
+
+        if ((shelfX + width) > DGAtlasSize) {
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        if ((shelfY + height) > DGAtlasSize) {
+            page++;
+            shelfX = 0;
+            shelfY = 0;
+            shelfHeight = 0;
+        }
+
+        image.page = page;
+        image.x = shelfX;
+        image.y = shelfY;
+
+        shelfX += width;
+        shelfHeight = max(shelfHeight, height);
+    }
+
+    bundle.name = string(DGAtlasIndex).substr(0, string(DGAtlasIndex).rfind('.'));
+    bundle.arrayOfFaces.resize(page + 1);
+
+    for (unsigned int i = 0; i < bundle.arrayOfFaces.size(); i++) {
+        DGBakeFace &face = bundle.arrayOfFaces[i];
+
+        face.index = i;
+        face.channels = 4;
+        face.format = TEXFormatRGBA;
+        face.width = DGAtlasSize;
+        face.height = DGAtlasSize;
+        face.numLevels = 1;
+        face.levelSize[0] = DGAtlasSize * DGAtlasSize * 4;
+        face.data.assign(face.levelSize[0], 0);
+        face.isDone = true;
+    }
+
+    snprintf(fileName, DGMaxFileLength, "%s/%s", outputFolder, DGAtlasIndex);
+    fh = fopen(fileName, "w");
+
+    if (!fh)
+        return false;
+
+    // Each image is surrounded by a copy of its edges, then listed
+    // with its position inside the border
+    for (unsigned int i = 0; i < arrayOfImages.size(); i++) {
+        DGBakeImage &image = arrayOfImages[i];
+        unsigned char* target = &bundle.arrayOfFaces[image.page].data[0];
+
+        // Shared images only list where the first one went
+        if (image.original < 0) {
+            for (int row = 0; row < image.height + (DGAtlasBorder * 2); row++) {
+                int sourceRow = _clamp(row - DGAtlasBorder, 0, image.height - 1);
+
+                for (int column = 0; column < image.width + (DGAtlasBorder * 2); column++) {
+                    int sourceColumn = _clamp(column - DGAtlasBorder, 0, image.width - 1);
+
+                    memcpy(&target[((image.y + row) * DGAtlasSize + image.x + column) * 4],
+                           &image.pixels[(sourceRow * image.width + sourceColumn) * 4], 4);
+                }
+            }
+        }
+
+        fprintf(fh, "%s %d %d %d %d %d\n", image.fileName.c_str(), image.page,
+                image.x + DGAtlasBorder, image.y + DGAtlasBorder, image.width, image.height);
+
+        stbi_image_free(image.pixels);
+    }
+
+    fclose(fh);
+
+    printf("Packed %d images in %d pages, %d of them shared\n", (int)arrayOfImages.size(),
+           page + 1, numShared);
+
+    // The pages stay plain RGBA, so only packing makes them smaller
+    if (packCodec >= 0) {
+        for (unsigned int i = 0; i < bundle.arrayOfFaces.size(); i++)
+            _pack(bundle.arrayOfFaces[i].data);
+    }
+
+    return _write(bundle, outputFolder, (packCodec >= 0) ? 2 : 0);
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Main
+////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[]) {
+    vector<DGBakeBundle> arrayOfBundles;
+    vector<DGBakeBundle>::iterator it;
+    pthread_t threads[DGBakeMaxThreads];
+    int numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int option, result = 0;
+    bool packAtlas = false;
+
+    while ((option = getopt(argc, argv, "aj:p:t:u")) != -1) {
+        if (option == 'a')
+            packAtlas = true;
+        else if (option == 'j')
+            numThreads = atoi(optarg);
+        else if ((option == 'p') && (strcmp(optarg, "zlib") == 0))
+            packCodec = TEXCodecZlib;
+        else if ((option == 'p') && (strcmp(optarg, "lz4") == 0))
+            packCodec = TEXCodecLZ4;
+        else if (option == 't')
+            tileSize = max(atoi(optarg), DGBakeMinTileSize);
+        else if (option == 'u')
+            isUncompressed = true;
+        else {
+            fprintf(stderr, "Usage: %s [-a] [-j threads] [-p zlib|lz4] [-t tile size] [-u] <input folder> [output folder]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-a] [-j threads] [-p zlib|lz4] [-t tile size] [-u] <input folder> [output folder]\n", argv[0]);
+        return 1;
+    }
+
+    const char* inputFolder = argv[optind];
+    const char* outputFolder = (optind + 1 < argc) ? argv[optind + 1] : inputFolder;
+
+    if (packAtlas)
+        return _bakeAtlas(inputFolder, outputFolder) ? 0 : 1;
+
+    numThreads = _clamp(numThreads, 1, DGBakeMaxThreads);
+
+    _scan(inputFolder, arrayOfBundles);
+
+    // Faces are sorted by index and must have no gaps, as bundles are
+    // indexed by their position
+    it = arrayOfBundles.begin();
+
+    while (it != arrayOfBundles.end()) {
+        bool isValid = true;
+
+        sort((*it).arrayOfFaces.begin(), (*it).arrayOfFaces.end(), _faceSort);
+
+        for (unsigned int i = 0; i < (*it).arrayOfFaces.size(); i++) {
+            if ((*it).arrayOfFaces[i].index != (int)i)
+                isValid = false;
+        }
+
+        if (isValid) {
+            for (unsigned int i = 0; i < (*it).arrayOfFaces.size(); i++)
+                arrayOfJobs.push_back(&(*it).arrayOfFaces[i]);
+
+            it++;
+        }
+        else {
+            fprintf(stderr, "Skipping %s: the sequence is incomplete\n", (*it).name.c_str());
+            it = arrayOfBundles.erase(it);
+            result = 1;
+        }
+    }
+
+    printf("Baking %d images in %d bundles with %d threads\n", (int)arrayOfJobs.size(),
+           (int)arrayOfBundles.size(), numThreads);
+
+    for (int i = 0; i < numThreads; i++)
+        pthread_create(&threads[i], NULL, _worker, NULL);
+
+    for (int i = 0; i < numThreads; i++)
+        pthread_join(threads[i], NULL);
+
+    for (it = arrayOfBundles.begin(); it != arrayOfBundles.end(); it++) {
+        bool isDone = true;
+
+        for (unsigned int i = 0; i < (*it).arrayOfFaces.size(); i++) {
+            if (!(*it).arrayOfFaces[i].isDone)
+                isDone = false;
+        }
+
+        if (isDone && _write(*it, outputFolder, (packCodec >= 0) ? 2 : (isUncompressed ? 0 : 1)))
+            printf("%s.%s\n", (*it).name.c_str(), DGDefTexExtension);
+        else {
+            fprintf(stderr, "Couldn't bake %s\n", (*it).name.c_str());
+            result = 1;
+        }
+    }
+
+    if (sharedBytes)
+        printf("Repeated faces stored once, saving %ld KB\n", sharedBytes / 1024);
+
+    return result;
+}
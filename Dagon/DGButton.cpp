@@ -18,6 +18,7 @@
 #include "DGConfig.h"
 #include "DGFontManager.h"
 #include "DGTexture.h"
+#include "DGTextureManager.h"
 
 using namespace std;
 
@@ -28,6 +29,7 @@ using namespace std;
 DGButton::DGButton() {
     config = &DGConfig::getInstance();
     fontManager = &DGFontManager::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     
     _textColor = DGColorWhite;
     
@@ -86,6 +88,10 @@ DGTexture* DGButton::onHoverTexture() {
     return _attachedOnHoverTexture;
 }
 
+float* DGButton::onHoverTexCoords() {
+    return _arrayOfOnHoverTexCoords;
+}
+
 const char* DGButton::text() {
     return _text.c_str();
 }
@@ -107,25 +113,25 @@ void DGButton::setAction(DGAction* anAction) {
 void DGButton::setFont(const char* fromFileName, unsigned int heightOfFont) {
     // FIXME: Wrong, this will load many repeated fonts!
     _font = fontManager->load(fromFileName, heightOfFont);
+    
+    if (_hasText)
+        _font->preload(_text.c_str());
 }
 
 void DGButton::setOnHoverTexture(const char* fromFileName) {
-    // TODO: Important! Should determine first if the texture already exists,
-    // to avoid repeating resources. Eventually, this would be done with the
-    // resource manager.
-    DGTexture* texture;
+    DGSize size;
     
-    texture = new DGTexture;
-    texture->setResource(config->path(DGPathRes, fromFileName, DGObjectImage));
-    texture->load();
-    
-    _attachedOnHoverTexture = texture;
+    // Like any other image, this is shared with those of the same file or contents
+    _attachedOnHoverTexture = textureManager->requestImage(config->path(DGPathRes, fromFileName, DGObjectImage),
+                                                           _arrayOfOnHoverTexCoords, &size);
     _hasOnHoverTexture = true;
 }
 
 void DGButton::setText(const char* text){
     _text = text;
     _hasText = true;
+    
+    _font->preload(text);
 }
 
 void DGButton::setTextColor(int aColor) {
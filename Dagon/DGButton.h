@@ -29,6 +29,7 @@ class DGConfig;
 class DGFont;
 class DGFontManager;
 class DGTexture;
+class DGTextureManager;
 
 ////////////////////////////////////////////////////////////
 // Interface
@@ -37,12 +38,14 @@ class DGTexture;
 class DGButton : public DGImage {
     DGConfig* config;
     DGFontManager* fontManager;
+    DGTextureManager* textureManager;
     
     int _textColor;
     
     DGAction* _actionData;
     DGFont* _font;
-    DGTexture* _attachedOnHoverTexture;
+    DGTexture* _attachedOnHoverTexture; // May be shared with other images
+    float _arrayOfOnHoverTexCoords[8];
     std::string _text;
     
     bool _hasAction;
@@ -66,6 +69,7 @@ public:
     DGAction* action();
     DGFont* font();
     DGTexture* onHoverTexture();
+    float* onHoverTexCoords(); // Of the image in its texture
     const char* text();
     int textColor();
     
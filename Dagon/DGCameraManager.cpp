@@ -47,6 +47,24 @@ bool DGCameraManager::canWalk() {
     return _canWalk;
 }
 
+bool DGCameraManager::isInView(DGVector direction, float radius) {
+    double length = sqrt((direction.x * direction.x) + (direction.y * direction.y) +
+                         (direction.z * direction.z));
+    double lookLength = sqrt((_orientation[0] * _orientation[0]) + (_orientation[1] * _orientation[1]) +
+                             (_orientation[2] * _orientation[2]));
+    double aspect = (double)_viewport.width / (double)_viewport.height;
+    double halfFov = tan((_fovCurrent / 2.0) * M_PI / 180.0);
+    
+    if ((length == 0.0) || (lookLength == 0.0))
+        return true;
+    
+    double angle = acos(((direction.x * _orientation[0]) + (direction.y * _orientation[1]) +
+                         (direction.z * _orientation[2])) / (length * lookLength));
+    
+    // The cone around the corners of the view contains the frustum
+    return (angle <= atan(halfFov * sqrt(1.0 + (aspect * aspect))) + radius);
+}
+
 bool DGCameraManager::isPanning() {
     return _isPanning;
 }
@@ -85,6 +103,49 @@ int DGCameraManager::cursorWhenPanning() {
         return DGCursorNormal;
 }
 
+DGVector DGCameraManager::directionOf(int xPosition, int yPosition) {
+    double aspect = (double)_viewport.width / (double)_viewport.height;
+    double halfFov = tan((_fovCurrent / 2.0) * M_PI / 180.0);
+    double x = ((2.0 * xPosition / _viewport.width) - 1.0) * halfFov * aspect;
+    double y = (1.0 - (2.0 * yPosition / _viewport.height)) * halfFov;
+    double look[3] = {_orientation[0], _orientation[1], _orientation[2]};
+    double right[3], up[3];
+    double length;
+    DGVector direction;
+    
+    length = sqrt((look[0] * look[0]) + (look[1] * look[1]) + (look[2] * look[2]));
+    
+    for (int i = 0; i < 3; i++)
+        look[i] /= length;
+    
+    // The view is never rolled, so right is always horizontal
+    right[0] = -look[2];
+    right[1] = 0.0;
+    right[2] = look[0];
+    
+    length = sqrt((right[0] * right[0]) + (right[2] * right[2]));
+    
+    if (length > 0.0) {
+        right[0] /= length;
+        right[2] /= length;
+    }
+    
+    up[0] = (right[1] * look[2]) - (right[2] * look[1]);
+    up[1] = (right[2] * look[0]) - (right[0] * look[2]);
+    up[2] = (right[0] * look[1]) - (right[1] * look[0]);
+    
+    direction.x = look[0] + (right[0] * x) + (up[0] * y);
+    direction.y = look[1] + (right[1] * x) + (up[1] * y);
+    direction.z = look[2] + (right[2] * x) + (up[2] * y);
+    
+    return direction;
+}
+
+int DGCameraManager::faceResolution() {
+    // Half a face spans one unit from the center of the cube
+    return (int)(_viewport.height / tan((_fovCurrent / 2.0) * M_PI / 180.0));
+}
+
 float DGCameraManager::fieldOfView() {
     return _fovCurrent;
 }
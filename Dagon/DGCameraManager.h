@@ -162,6 +162,10 @@ public:
     
     bool canBreathe();
     bool canWalk();
+    
+    // True if the cone with the given axis and angle, in radians, may
+    // be seen. Used to cull the parts of the cube around the view.
+    bool isInView(DGVector direction, float radius);
     bool isPanning();
     
     // Gets
@@ -169,6 +173,11 @@ public:
     int angleHorizontal();
     int angleVertical();
     int cursorWhenPanning();
+    DGVector directionOf(int xPosition, int yPosition); // Of a point in the viewport
+    
+    // Size of a face of the cube at which a texel covers about
+    // a pixel in the center of the view
+    int faceResolution();
     float fieldOfView();
     int inertia();
     int maxSpeed();
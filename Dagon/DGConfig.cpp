@@ -33,7 +33,9 @@ DGConfig::DGConfig() {
     autopaths = DGDefAutopaths;
     autorun = DGDefAutorun;
     bundleEnabled = DGDefBundleEnabled;
+    cacheBudget = DGDefCacheBudget;
     controlMode = DGDefControlMode;
+    cubeMaps = DGDefCubeMaps;
 	displayWidth = DGDefDisplayWidth;
 	displayHeight = DGDefDisplayHeight;
 	displayDepth = DGDefDisplayDepth;
@@ -45,12 +47,19 @@ DGConfig::DGConfig() {
 	effects = DGDefEffects;
 	log = DGDefLog;
     mute = DGDefMute;
+    prefetchBudget = DGDefPrefetchBudget;
+    prefetchDepth = DGDefPrefetchDepth;
+    previewSize = DGDefPreviewSize;
     showHelpers = DGDefShowHelpers;
 	showSplash = DGDefShowSplash;
 	showSpots = DGDefShowSpots;
     silentFeeds = DGDefSilentFeeds;
 	texCompression = DGDefTexCompression;
     subtitles = DGDefSubtitles;
+    textureBudget = DGDefTextureBudget;
+    textureLowWater = DGDefTextureLowWater;
+    uploadBudget = DGDefUploadBudget;
+    uploadTime = DGDefUploadTime;
 	verticalSync = DGDefVerticalSync;
 	
     _fps = 0;
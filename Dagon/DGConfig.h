@@ -36,7 +36,9 @@ enum DGConfigDefaults {
     DGDefAutopaths = true,    
     DGDefAutorun = true,
     DGDefBundleEnabled = true,
+    DGDefCacheBudget = 256,
     DGDefControlMode = DGMouseFree,
+	DGDefCubeMaps = true,
 	DGDefDisplayWidth = 1280,
 	DGDefDisplayHeight = 800,
 	DGDefDisplayDepth = 24,
@@ -48,12 +50,19 @@ enum DGConfigDefaults {
 	DGDefFullScreen = false,
 	DGDefLog = true,
     DGDefMute = false,
+    DGDefPrefetchBudget = 128,
+    DGDefPrefetchDepth = 1,
+    DGDefPreviewSize = 128,
     DGDefShowHelpers = false,
 	DGDefShowSplash = true,
 	DGDefShowSpots = false,
     DGDefSilentFeeds = false,
 	DGDefSubtitles = true,
 	DGDefTexCompression = false,
+	DGDefTextureBudget = 512,
+	DGDefTextureLowWater = 75,
+	DGDefUploadBudget = 4096,
+	DGDefUploadTime = 4,
 	DGDefVerticalSync = true
 };
 
@@ -99,7 +108,9 @@ public:
     bool autopaths;
     bool autorun;
     bool bundleEnabled;
+    int cacheBudget; // In megabytes, zero to disable
     int controlMode;
+    bool cubeMaps;
     int displayWidth;
 	int displayHeight;
 	int displayDepth;
@@ -111,12 +122,19 @@ public:
 	bool fullScreen;
     bool log;
     bool mute;
+    int prefetchBudget; // In megabytes
+    int prefetchDepth;
+    int previewSize; // In pixels, zero to disable
     bool showHelpers;
     bool showSplash;
 	bool showSpots;
     bool subtitles;
     bool silentFeeds;
     bool texCompression;
+    int textureBudget; // In megabytes
+    int textureLowWater; // Percentage of the budget left once it is exceeded
+    int uploadBudget; // In kilobytes per frame, zero for no limit
+    int uploadTime; // In milliseconds per frame, zero for no limit
 	bool verticalSync;
     
     float globalSpeed();
@@ -64,11 +64,21 @@ static int DGConfigLibGet(lua_State *L) {
 		return 1;
 	}
     
+    if (strcmp(key, "cacheBudget") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().cacheBudget);
+		return 1;
+	}
+    
     if (strcmp(key, "controlMode") == 0) {
 		lua_pushnumber(L, DGConfig::getInstance().controlMode);
 		return 1;
 	}
 	
+    if (strcmp(key, "cubeMaps") == 0) {
+		lua_pushboolean(L, DGConfig::getInstance().cubeMaps);
+		return 1;
+	}
+    
 	if (strcmp(key, "displayWidth") == 0) {
 		lua_pushnumber(L, DGConfig::getInstance().displayWidth);
 		return 1;
@@ -129,6 +139,21 @@ static int DGConfigLibGet(lua_State *L) {
 		return 1;
 	}
     
+    if (strcmp(key, "prefetchBudget") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().prefetchBudget);
+		return 1;
+	}
+    
+    if (strcmp(key, "prefetchDepth") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().prefetchDepth);
+		return 1;
+	}
+    
+    if (strcmp(key, "previewSize") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().previewSize);
+		return 1;
+	}
+    
     if (strcmp(key, "showHelpers") == 0) {
 		lua_pushboolean(L, DGConfig::getInstance().showHelpers);
 		return 1;
@@ -164,6 +189,26 @@ static int DGConfigLibGet(lua_State *L) {
 		return 1;
 	}
 
+    if (strcmp(key, "textureBudget") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().textureBudget);
+		return 1;
+	}
+    
+    if (strcmp(key, "textureLowWater") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().textureLowWater);
+		return 1;
+	}
+    
+    if (strcmp(key, "uploadBudget") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().uploadBudget);
+		return 1;
+	}
+    
+    if (strcmp(key, "uploadTime") == 0) {
+		lua_pushnumber(L, DGConfig::getInstance().uploadTime);
+		return 1;
+	}
+    
 	if (strcmp(key, "verticalSync") == 0) {
 		lua_pushboolean(L, DGConfig::getInstance().verticalSync);
 		return 1;
@@ -193,12 +238,18 @@ static int DGConfigLibSet(lua_State *L) {
     if (strcmp(key, "bundleEnabled") == 0)
 		DGConfig::getInstance().bundleEnabled = (bool)lua_toboolean(L, 3);    
     
+    if (strcmp(key, "cacheBudget") == 0)
+		DGConfig::getInstance().cacheBudget = (int)luaL_checknumber(L, 3);
+    
     if (strcmp(key, "controlMode") == 0) {
 		DGConfig::getInstance().controlMode = (int)luaL_checknumber(L, 3);
         // Must refresh the viewport
         DGCameraManager::getInstance().setViewport(DGConfig::getInstance().displayWidth, DGConfig::getInstance().displayHeight);
     }
 	
+    if (strcmp(key, "cubeMaps") == 0)
+		DGConfig::getInstance().cubeMaps = (bool)lua_toboolean(L, 3);
+    
 	if (strcmp(key, "displayWidth") == 0)
 		DGConfig::getInstance().displayWidth = (int)luaL_checknumber(L, 3);
 	
@@ -235,6 +286,15 @@ static int DGConfigLibSet(lua_State *L) {
     if (strcmp(key, "script") == 0)
         DGConfig::getInstance().setScript(luaL_checkstring(L, 3));
     
+    if (strcmp(key, "prefetchBudget") == 0)
+		DGConfig::getInstance().prefetchBudget = (int)luaL_checknumber(L, 3);
+    
+    if (strcmp(key, "prefetchDepth") == 0)
+		DGConfig::getInstance().prefetchDepth = (int)luaL_checknumber(L, 3);
+    
+    if (strcmp(key, "previewSize") == 0)
+		DGConfig::getInstance().previewSize = (int)luaL_checknumber(L, 3);
+    
 	if (strcmp(key, "showHelpers") == 0)
 		DGConfig::getInstance().showHelpers = (bool)lua_toboolean(L, 3);    
 	
@@ -256,6 +316,18 @@ static int DGConfigLibSet(lua_State *L) {
 	if (strcmp(key, "texExtension") == 0)
         DGConfig::getInstance().setTexExtension(luaL_checkstring(L, 3));
     
+    if (strcmp(key, "textureBudget") == 0)
+		DGConfig::getInstance().textureBudget = (int)luaL_checknumber(L, 3);
+    
+    if (strcmp(key, "textureLowWater") == 0)
+		DGConfig::getInstance().textureLowWater = (int)luaL_checknumber(L, 3);
+    
+    if (strcmp(key, "uploadBudget") == 0)
+		DGConfig::getInstance().uploadBudget = (int)luaL_checknumber(L, 3);
+    
+    if (strcmp(key, "uploadTime") == 0)
+		DGConfig::getInstance().uploadTime = (int)luaL_checknumber(L, 3);
+    
 	if (strcmp(key, "verticalSync") == 0)
 		DGConfig::getInstance().verticalSync = (bool)lua_toboolean(L, 3);
 	
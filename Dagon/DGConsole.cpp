@@ -21,6 +21,7 @@
 #include "DGLog.h"
 #include "DGFontManager.h"
 #include "DGRenderManager.h"
+#include "DGTextureManager.h"
 
 using namespace std;
 
@@ -35,6 +36,7 @@ DGConsole::DGConsole() {
     fontManager = &DGFontManager::getInstance();
     log = &DGLog::getInstance();
     renderManager = &DGRenderManager::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     
     _command = "";
     
@@ -140,6 +142,13 @@ void DGConsole::update() {
                              "Viewing angle: %2.1f", cameraManager->fieldOfView());
                 _font->print(DGInfoMargin, (DGInfoMargin * 4) + (DGDefFontSize * 3 + 20), 
                              "FPS: %d", config->framesPerSecond()); 
+                _font->print(DGInfoMargin, (DGInfoMargin * 5) + (DGDefFontSize * 4 + 20), 
+                             "Textures: %lu hits, %lu misses, %lu evictions, %lu KB shared",
+                             textureManager->hits(), textureManager->misses(),
+                             textureManager->evictions(), textureManager->sharedBytes() / 1024);
+                _font->print(DGInfoMargin, (DGInfoMargin * 6) + (DGDefFontSize * 5 + 20), 
+                             "Uploads: %lu KB, %lu KB deferred", textureManager->uploadedBytes() / 1024,
+                             textureManager->deferredBytes() / 1024);
                 
                 break;            
             case DGConsoleHiding:
@@ -43,6 +43,7 @@ class DGFont;
 class DGFontManager;
 class DGLog;
 class DGRenderManager;
+class DGTextureManager;
 
 ////////////////////////////////////////////////////////////
 // Interface
@@ -55,6 +56,7 @@ class DGConsole {
     DGFontManager* fontManager;
     DGLog* log;
     DGRenderManager* renderManager;
+    DGTextureManager* textureManager;
     
     DGFont* _font;
     
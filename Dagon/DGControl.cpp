@@ -53,6 +53,7 @@ DGControl::DGControl() {
     renderManager = &DGRenderManager::getInstance();    
     script = &DGScript::getInstance();
     system = &DGSystem::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     timerManager = &DGTimerManager::getInstance();
     videoManager = &DGVideoManager::getInstance();
     
@@ -61,6 +62,10 @@ DGControl::DGControl() {
     _fpsCount = 0;
     _sleepTimer = 0;
     
+    _hasPreload = false;
+    _preloadHandler = 0;
+    _preloadObject = 0;
+    
     _isInitialized = false;
     _isShuttingDown = false;
 	_isRunning = false;
@@ -96,7 +101,6 @@ DGControl::~DGControl() {
         delete _interface;
         delete _state;
         delete _scene;
-        delete _textureManager;
     }
 }
 
@@ -127,11 +131,13 @@ void DGControl::init() {
     
     feedManager->init();
     
+    // Init the texture manager (the loaders are created later)
+    textureManager->init();
+    
     _interface = new DGInterface;
     _scene = new DGScene;
     
     _state = new DGState;
-    _textureManager = new DGTextureManager;
     
     _dragTimer = timerManager->createManual(DGTimeToStartDragging);
     timerManager->disable(_dragTimer);
@@ -194,6 +200,36 @@ void DGControl::lookAt(float horizontal, float vertical, bool instant) {
     }
 }
 
+void DGControl::preload(DGRoom* room, int handlerForLua) {
+    vector<DGNode*> arrayOfNodes = room->arrayOfNodes();
+    vector<DGTexture*> arrayOfTextures;
+    vector<string> arrayOfFiles;
+    
+    for (unsigned int i = 0; i < arrayOfNodes.size(); i++)
+        _collectResources(arrayOfNodes[i], arrayOfTextures, arrayOfFiles);
+    
+    // Along with the ambient audios of the room
+    if (room->hasAudios()) {
+        vector<DGAudio*> arrayOfAudios = room->arrayOfAudios();
+        
+        for (unsigned int i = 0; i < arrayOfAudios.size(); i++)
+            arrayOfAudios[i]->appendFiles(arrayOfFiles);
+    }
+    
+    if (room->hasDefaultFootstep())
+        room->defaultFootstep()->appendFiles(arrayOfFiles);
+    
+    textureManager->preload(arrayOfTextures, arrayOfFiles);
+    
+    // A preload in progress is replaced, and its handler no longer called
+    if (_hasPreload)
+        script->releaseHandler(_preloadHandler);
+    
+    _preloadHandler = handlerForLua;
+    _preloadObject = room->luaObject();
+    _hasPreload = true;
+}
+
 void DGControl::processFunctionKey(int aKey) {
     int idx = 0;
     
@@ -533,7 +569,7 @@ void DGControl::registerHotkey(int aKey, const char* luaCommandToExecute) {
 void DGControl::registerObject(DGObject* theTarget) {
     switch (theTarget->type()) {
         case DGObjectNode:
-             _textureManager->requestBundle((DGNode*)theTarget);
+             textureManager->requestBundle((DGNode*)theTarget);
             break;
         case DGObjectOverlay:
             _interface->addOverlay((DGOverlay*)theTarget);
@@ -589,6 +625,7 @@ void DGControl::switchTo(DGObject* theTarget) {
                 
                 _currentRoom = (DGRoom*)theTarget;
                 _scene->setRoom((DGRoom*)theTarget);
+                _updateDistances();
                 timerManager->setLuaObject(_currentRoom->luaObject());
                 
                 if (!_currentRoom->hasNodes()) {
@@ -669,7 +706,9 @@ void DGControl::switchTo(DGObject* theTarget) {
         if (_currentRoom->hasNodes()) {
             // Now we proceed to load the textures of the current node
             DGNode* currentNode = _currentRoom->currentNode();
-            _textureManager->flush();
+            
+            if (currentNode->hasCubeMap())
+                textureManager->requestTexture(currentNode->cubeMap());
                 
             if (currentNode->hasSpots()) {                
                 currentNode->beginIteratingSpots();
@@ -706,22 +745,25 @@ void DGControl::switchTo(DGObject* theTarget) {
                         }
                     }
                     
-                    if (spot->hasTexture()) {
-                        _textureManager->requestTexture(spot->texture());
-                        
-                        // Only resize if nothing but origin
-                        if (spot->vertexCount() == 1)
-                            spot->resize(spot->texture()->width(), spot->texture()->height());
-                    }
+                    // Note the spot is resized by the scene once the texture is ready.
+                    // Those in view are loaded first.
+                    if (spot->hasTexture())
+                        textureManager->requestTexture(spot->texture(), spot->direction());
                     
                     if (spot->hasFlag(DGSpotAuto))
                         spot->play();
                 } while (currentNode->iterateSpots());
             }
-            else {
+            else if (!currentNode->hasCubeMap() && !currentNode->hasTileSet()) {
                 log->warning(DGModControl, "%s", DGMsg130001);
             }
             
+            // Warm up whatever the player is likely to visit next
+            _prefetch(currentNode);
+            
+            // And make room for all of it
+            textureManager->flush();
+            
             // Prepare the name for the window
             char title[DGMaxObjectName];
             snprintf(title, DGMaxObjectName, "%s (%s, %s)", config->script(), 
@@ -883,6 +925,82 @@ bool DGControl::update() {
 // Implementation - Private methods
 ////////////////////////////////////////////////////////////
 
+// Appends the textures and files the node needs
+void DGControl::_collectResources(DGNode* node, vector<DGTexture*> &arrayOfTextures, vector<string> &arrayOfFiles) {
+    if (node->hasCubeMap())
+        arrayOfTextures.push_back(node->cubeMap());
+    
+    // Enough to draw the node, the rest streams in once there
+    if (node->hasTileSet())
+        textureManager->appendBaseTiles(node->tileSet(), arrayOfTextures);
+    
+    if (!node->hasSpots())
+        return;
+    
+    node->beginIteratingSpots();
+    do {
+        DGSpot* spot = node->currentSpot();
+        
+        // Video frames are handled by the video manager
+        if (spot->hasTexture() && !spot->hasVideo())
+            arrayOfTextures.push_back(spot->texture());
+        
+        if (spot->hasAudio())
+            spot->audio()->appendFiles(arrayOfFiles); // Randomized ones are expanded
+        
+        if (spot->hasVideo())
+            arrayOfFiles.push_back(spot->video()->resource());
+    } while (node->iterateSpots());
+}
+
+void DGControl::_prefetch(DGNode* fromNode) {
+    vector<DGNode*> arrayOfNodes;
+    vector<DGTexture*> arrayOfTextures;
+    vector<string> arrayOfFiles;
+    unsigned int first = 0;
+    
+    // Walk the graph of switches breadth first, so that the
+    // nearest nodes are prefetched before the rest
+    arrayOfNodes.push_back(fromNode);
+    
+    for (int depth = 0; depth < config->prefetchDepth; depth++) {
+        unsigned int last = arrayOfNodes.size();
+        
+        for (unsigned int i = first; i < last; i++) {
+            DGNode* node = arrayOfNodes[i];
+            
+            if (!node->hasSpots())
+                continue;
+            
+            node->beginIteratingSpots();
+            do {
+                DGSpot* spot = node->currentSpot();
+                
+                if (spot->hasAction() && spot->isEnabled()) {
+                    DGAction* action = spot->action();
+                    
+                    if ((action->type == DGActionSwitch) && action->target) {
+                        if (action->target->isType(DGObjectNode) || action->target->isType(DGObjectSlide)) {
+                            DGNode* target = (DGNode*)action->target;
+                            
+                            if (find(arrayOfNodes.begin(), arrayOfNodes.end(), target) == arrayOfNodes.end())
+                                arrayOfNodes.push_back(target);
+                        }
+                    }
+                }
+            } while (node->iterateSpots());
+        }
+        
+        first = last;
+    }
+    
+    // Now collect the resources of every neighbour, skipping the current node
+    for (unsigned int i = 1; i < arrayOfNodes.size(); i++)
+        _collectResources(arrayOfNodes[i], arrayOfTextures, arrayOfFiles);
+    
+    textureManager->prefetch(arrayOfTextures, arrayOfFiles);
+}
+
 void DGControl::_processAction(){
     DGAction* action = cursorManager->action();
     
@@ -896,10 +1014,72 @@ void DGControl::_processAction(){
             }
             else feedManager->show(action->feed);
             break;
-        case DGActionSwitch:
+        case DGActionSwitch: {
+            DGPoint position = cursorManager->position();
+            
+            // The faces around the spot are loaded first in the next node
+            textureManager->setFocus(cameraManager->directionOf(position.x, position.y));
+            
             cursorManager->removeAction();
             switchTo(action->target);
             break;
+        }
+    }
+}
+
+// Rooms are as far from the current one as the switches between them, so
+// that the textures of those less likely to be visited are evicted first
+void DGControl::_updateDistances() {
+    vector<DGRoom*> arrayOfRooms;
+    vector<int> arrayOfDistances;
+    unsigned int first = 0;
+    
+    arrayOfRooms.push_back(_currentRoom);
+    arrayOfDistances.push_back(0);
+    
+    // Breadth first, as in _prefetch
+    while (first < arrayOfRooms.size()) {
+        vector<DGNode*> arrayOfNodes = arrayOfRooms[first]->arrayOfNodes();
+        
+        for (unsigned int i = 0; i < arrayOfNodes.size(); i++) {
+            DGNode* node = arrayOfNodes[i];
+            
+            if (!node->hasSpots())
+                continue;
+            
+            node->beginIteratingSpots();
+            do {
+                DGSpot* spot = node->currentSpot();
+                
+                if (spot->hasAction()) {
+                    DGAction* action = spot->action();
+                    
+                    if ((action->type == DGActionSwitch) && action->target &&
+                        action->target->isType(DGObjectRoom) &&
+                        (find(arrayOfRooms.begin(), arrayOfRooms.end(), action->target) == arrayOfRooms.end())) {
+                        arrayOfRooms.push_back((DGRoom*)action->target);
+                        arrayOfDistances.push_back(arrayOfDistances[first] + 1);
+                    }
+                }
+            } while (node->iterateSpots());
+        }
+        
+        first++;
+    }
+    
+    for (unsigned int i = 0; i < _arrayOfRooms.size(); i++) {
+        vector<DGRoom*>::iterator it = find(arrayOfRooms.begin(), arrayOfRooms.end(), _arrayOfRooms[i]);
+        vector<DGNode*> arrayOfNodes = _arrayOfRooms[i]->arrayOfNodes();
+        int distance;
+        
+        // Rooms only reached from scripts are the farthest
+        if (it != arrayOfRooms.end())
+            distance = arrayOfDistances[it - arrayOfRooms.begin()];
+        else
+            distance = arrayOfRooms.size();
+        
+        for (unsigned int j = 0; j < arrayOfNodes.size(); j++)
+            textureManager->setDistance(arrayOfNodes[j], distance);
     }
 }
 
@@ -909,6 +1089,23 @@ void DGControl::_updateView(int state, bool inBackground) {
     // IMPORTANT: Ensure this function is thread-safe when
     // switching rooms or nodes
     
+    // Upload the textures decoded since the last update
+    textureManager->process();
+    
+    // Report how far the preload went, one last time once it's done
+    if (_hasPreload) {
+        float progress = textureManager->preloadProgress();
+        int handler = _preloadHandler; // The callback may start another preload
+        
+        if (progress >= 1.0f)
+            _hasPreload = false;
+        
+        script->processCallback(handler, _preloadObject, progress);
+        
+        if (progress >= 1.0f)
+            script->releaseHandler(handler);
+    }
+    
     // Setup the scene
     
     _scene->clear();
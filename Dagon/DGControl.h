@@ -46,6 +46,7 @@ class DGScript;
 class DGSpot;
 class DGState;
 class DGSystem;
+class DGTexture;
 class DGTextureManager;
 class DGTimerManager;
 class DGVideoManager;
@@ -122,6 +123,7 @@ class DGControl {
     DGRenderManager* renderManager;
     DGScript* script;
     DGSystem* system;
+    DGTextureManager* textureManager;
     DGTimerManager* timerManager;
     DGVideoManager* videoManager;    
     
@@ -133,7 +135,6 @@ class DGControl {
     DGScene* _scene;   
     DGSpot* _syncedSpot;
     DGState* _state;
-    DGTextureManager* _textureManager;
     
     DGEventHandlers _eventHandlers;
     DGHotkeyData _hotkeyData[DGMaxHotKeys];
@@ -147,8 +148,17 @@ class DGControl {
     bool _isShuttingDown;
 	int _shutdownTimer;
     int _sleepTimer;
+    
+    // Called back every frame with the progress of the room being preloaded
+    bool _hasPreload;
+    int _preloadHandler;
+    int _preloadObject;
 
+    void _collectResources(DGNode* node, std::vector<DGTexture*> &arrayOfTextures,
+                           std::vector<std::string> &arrayOfFiles);
+    void _prefetch(DGNode* fromNode);
     void _processAction();
+    void _updateDistances();
     void _updateView(int state, bool inBackground);
     
     // Private constructor/destructor
@@ -173,6 +183,10 @@ public:
     void cutscene(const char* fileName); 
 	bool isDirectControlActive();
     void lookAt(float horizontal, float vertical, bool instant);
+    
+    // Loads in the background what the nodes of the room need, calling the
+    // given function every frame with the progress, from 0 to 1, until done
+    void preload(DGRoom* room, int handlerForLua);
     void processFunctionKey(int aKey);
     void processKey(int aKey, int eventFlags);
     void processMouse(int x, int y, int eventFlags);
@@ -61,20 +61,25 @@ DGAction* DGCursorManager::action() {
     return _pointerToAction;
 }
 
-void DGCursorManager::bindImage() {
-    (*_current).image->bind();
-}
-
 float* DGCursorManager::arrayOfCoords() {
     return _arrayOfCoords;
 }
 
+float* DGCursorManager::arrayOfTexCoords() {
+    return (*_current).arrayOfTexCoords;
+}
+
 bool DGCursorManager::hasAction() {
     return _hasAction;
 }
 
 bool DGCursorManager::hasImage() {
-    return _hasImage;
+    // The default cursor is drawn until the image is uploaded
+    return _hasImage && (*_current).image->isLoaded();
+}
+
+DGTexture* DGCursorManager::image() {
+    return (*_current).image;
 }
 
 bool DGCursorManager::isDragging() {
@@ -84,14 +89,11 @@ bool DGCursorManager::isDragging() {
 // NOTE: These textures aren't managed
 void DGCursorManager::load(int type, const char* imageFromFile, int offsetX, int offsetY) {
     DGCursorData cursor;
-    DGTexture* texture;
-    
-    texture = new DGTexture;
-    texture->setResource(config->path(DGPathRes, imageFromFile, DGObjectCursor));
-    texture->load();
+    DGSize size;
     
     cursor.type = type;
-    cursor.image = texture;
+    cursor.image = DGTextureManager::getInstance().requestImage(config->path(DGPathRes, imageFromFile, DGObjectCursor),
+                                                                cursor.arrayOfTexCoords, &size);
     cursor.origin.x = _half - offsetX;
     cursor.origin.y = _half - offsetY;
 
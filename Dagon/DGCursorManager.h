@@ -33,7 +33,8 @@ class DGTexture;
 
 typedef struct {
     int type;
-    DGTexture* image;
+    DGTexture* image; // May be shared with other images
+    float arrayOfTexCoords[8];
     DGPoint origin;
 } DGCursorData;
 
@@ -77,10 +78,11 @@ public:
     }
 
     DGAction* action();
-    void bindImage();
     float* arrayOfCoords();   
+    float* arrayOfTexCoords();
     bool hasAction();
     bool hasImage();
+    DGTexture* image();
     bool isDragging();
     void load(int type, const char* imageFromFile, int offsetX = 0, int offsetY = 0);
     bool onButton();
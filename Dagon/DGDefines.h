@@ -26,6 +26,7 @@
 #define	DGDefResourcePath	"Resources/"
 #define	DGDefConfigFile		"Dagon.cfg"
 #define	DGDefLogFile		"Dagon.log"
+#define	DGDefCachePath		"Cache/" // Of compressed textures, under the user path
 #define DGDefTexExtension	"tex"
 #define DGDefTexSize		2048 // TODO: We should be able to read this value from each texture
 
@@ -86,6 +86,10 @@ void DGFeedManager::queue(const char* text, const char* audio) {
         strncpy(feed.audio, audio, DGMaxFileLength);
         
         _arrayOfFeeds.push_back(feed);
+        
+        // Render the glyphs while waiting rather than when shown
+        if (config->subtitles)
+            _feedFont->preload(feed.text);
     }
 }
 
@@ -110,14 +114,21 @@ void DGFeedManager::setFont(const char* fromFileName, unsigned int heightOfFont)
 void DGFeedManager::show(const char* text) {
     if (config->subtitles && (strcmp(text, "") != 0)) {
         string str = text;
+        size_t length = DGCountCharacters(text); // Not bytes, as text is UTF-8
         size_t maxChars = config->displayWidth / _feedHeight;
-        size_t even = str.length() / (str.length() / maxChars + 1);
+        size_t even = length / (length / maxChars + 1);
         size_t currSpace = 0;
         size_t nextSpace = 0;
         
         _dim();
         while (nextSpace != str.npos) {
-            nextSpace = str.find(" " , even + currSpace);
+            const char* c = str.c_str() + currSpace;
+            
+            // Skip as many characters as evenly fit a line, then find a space
+            for (size_t i = 0; i < even && *c; i++)
+                DGNextCharacter(&c);
+            
+            nextSpace = str.find(" ", c - str.c_str());
             string substr = str.substr(currSpace, (nextSpace - currSpace));
             
             DGFeed feed;
@@ -222,8 +233,7 @@ void DGFeedManager::update() {
 ////////////////////////////////////////////////////////////
 
 void DGFeedManager::_calculatePosition(DGFeed* feed) {
-    int width = (_feedHeight * 0.66f); // We have no option but to estimate this
-    size_t length = strlen(feed->text) * width;
+    int length = _feedFont->width(feed->text);
     
     feed->location.x = (config->displayWidth / 2) - (length / 2);
     feed->location.y = config->displayHeight - _feedHeight - DGFeedMargin;
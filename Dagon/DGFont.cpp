@@ -17,6 +17,9 @@
 #include "DGConfig.h"
 #include "DGFont.h"
 #include "DGLog.h"
+#include "DGTextureManager.h"
+
+using namespace std;
 
 ////////////////////////////////////////////////////////////
 // Implementation - Constructor
@@ -25,8 +28,13 @@
 DGFont::DGFont() {
     config = &DGConfig::getInstance();
     log = &DGLog::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     
+    _currentPage = 0;
+    _hasKerning = false;
     _isLoaded = false;
+    _pageSize = 0;
+    _stamp = 0;
     
     this->setType(DGObjectFont);
 }
@@ -45,8 +53,17 @@ DGFont::~DGFont() {
 
 void DGFont::clear() {
     if (_isLoaded) {
-        glDeleteTextures(128, _textures);
-        free(_textures);
+        vector<DGFontPage>::iterator it;
+        
+        it = _arrayOfPages.begin();
+        
+        while (it != _arrayOfPages.end()) {
+            glDeleteTextures(1, &(*it).texture);
+            it++;
+        }
+        
+        _arrayOfPages.clear();
+        _mapOfGlyphs.clear();
         FT_Done_Face(_face);
     }   
 }
@@ -55,62 +72,80 @@ bool DGFont::isLoaded() {
     return _isLoaded;
 }
 
+void DGFont::preload(const char* text) {
+    if (_isLoaded) {
+        _layout(text);
+        _trimPages();
+    }
+}
+
 void DGFont::print(int x, int y, const char* text, ...) {
     if (!_isLoaded)
         return;
     
 	char line[DGMaxFeedLength];
-    const char* c;
 	va_list	ap;
 	
 	if (text == NULL)
 		*line=0;
 	else {
 		va_start(ap, text);
-	    vsprintf(line, text, ap);
+	    vsnprintf(line, DGMaxFeedLength, text, ap);
 		va_end(ap);
 	}
 	
-	glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_TRANSFORM_BIT);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    _layout(line);
     
-    glPushMatrix();
-    glTranslatef(x, y, 0);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
-    c = line;
-    for (int j = 0; j < strlen(line); j++) {
-        int ch = *c;
-        
-        GLfloat texCoords[] = {	0, 0,
-            0, _glyph[ch].y,
-            _glyph[ch].x, _glyph[ch].y,
-            _glyph[ch].x, 0 };
-        
-        GLshort coords[] = { 0, 0,
-            0, _glyph[ch].rows,
-            _glyph[ch].width, _glyph[ch].rows,
-            _glyph[ch].width, 0 };
-        
-        glBindTexture(GL_TEXTURE_2D, _textures[ch]);
+    // Most lines are in one page, so they are usually a single call
+    for (int page = 0; page < (int)_arrayOfPages.size(); page++) {
+        vector<DGGlyph*>::iterator it;
+        FT_UInt previous = 0;
+        int penX = x;
         
-        glTranslatef((GLfloat)_glyph[ch].left, 0, 0);
+        if (_arrayOfPages[page].lastUse != _stamp)
+            continue;
         
-        glPushMatrix();
-        glTranslatef(0, -(GLfloat)_glyph[ch].top + _height, 0);
+        _arrayOfVertices.clear();
         
-        glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
-        glVertexPointer(2, GL_SHORT, 0, coords);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        it = _arrayOfLine.begin();
         
-        glPopMatrix();
-        glTranslatef((GLfloat)(_glyph[ch].advance >> 6), 0, 0);
+        while (it != _arrayOfLine.end()) {
+            DGGlyph* glyph = *it;
+            
+            penX += _kerning(previous, glyph->index);
+            
+            if (glyph->page == page) {
+                GLfloat left = (GLfloat)(penX + glyph->left);
+                GLfloat top = (GLfloat)(y + _height - glyph->top);
+                GLfloat right = left + glyph->width;
+                GLfloat bottom = top + glyph->rows;
+                
+                // Position and texture coordinates of two triangles
+                GLfloat quad[] = {left, top, glyph->texCoords[0], glyph->texCoords[1],
+                    right, top, glyph->texCoords[2], glyph->texCoords[1],
+                    right, bottom, glyph->texCoords[2], glyph->texCoords[3],
+                    left, top, glyph->texCoords[0], glyph->texCoords[1],
+                    right, bottom, glyph->texCoords[2], glyph->texCoords[3],
+                    left, bottom, glyph->texCoords[0], glyph->texCoords[3]};
+                
+                _arrayOfVertices.insert(_arrayOfVertices.end(), quad, quad + 24);
+            }
+            
+            penX += glyph->advance >> 6;
+            previous = glyph->index;
+            
+            it++;
+        }
         
-        c++;
+        glBindTexture(GL_TEXTURE_2D, _arrayOfPages[page].texture);
+        glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), &_arrayOfVertices[0]);
+        glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), &_arrayOfVertices[2]);
+        glDrawArrays(GL_TRIANGLES, 0, _arrayOfVertices.size() / 4);
     }
     
-    glPopMatrix();
-	
-	glPopAttrib();
+    _trimPages();
 }
 
 // FIXME: This is a repeated method from DGRenderManager - it would be best to avoid this
@@ -156,85 +191,201 @@ void DGFont::setResource(const char* fromFileName, unsigned int heightOfFont) {
     _isLoaded = true;  
 }
 
+int DGFont::width(const char* text) {
+    vector<DGGlyph*>::iterator it;
+    FT_UInt previous = 0;
+    int width = 0;
+    
+    if (!_isLoaded)
+        return 0;
+    
+    _layout(text);
+    
+    it = _arrayOfLine.begin();
+    
+    while (it != _arrayOfLine.end()) {
+        width += _kerning(previous, (*it)->index) + ((*it)->advance >> 6);
+        previous = (*it)->index;
+        
+        it++;
+    }
+    
+    _trimPages();
+    
+    return width;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - Private methods
 ////////////////////////////////////////////////////////////
 
+void DGFont::_clearPage(int page) {
+    GLubyte* blankData;
+    
+    _dropGlyphs(page);
+    
+    // Cleared, so that the borders between glyphs stay empty
+    blankData = (GLubyte*)calloc(2 * _pageSize * _pageSize, sizeof(GLubyte));
+    
+    glBindTexture(GL_TEXTURE_2D, _arrayOfPages[page].texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _pageSize, _pageSize,
+                    GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, blankData);
+    textureManager->chargeUpload(2 * _pageSize * _pageSize);
+    
+    free(blankData);
+    
+    _arrayOfPages[page].penX = 0;
+    _arrayOfPages[page].penY = 0;
+    _arrayOfPages[page].rowHeight = 0;
+    _arrayOfPages[page].lastUse = 0;
+}
+
+// Glyphs in the page are rendered again when next needed
+void DGFont::_dropGlyphs(int page) {
+    map<uint32_t, DGGlyph>::iterator it;
+    
+    it = _mapOfGlyphs.begin();
+    
+    while (it != _mapOfGlyphs.end()) {
+        if ((*it).second.page == page)
+            _mapOfGlyphs.erase(it++);
+        else
+            it++;
+    }
+}
+
+DGGlyph* DGFont::_glyph(uint32_t character) {
+    map<uint32_t, DGGlyph>::iterator it;
+    FT_BitmapGlyph bitmapGlyph;
+    FT_Glyph ftGlyph;
+    DGGlyph* glyph;
+    
+    it = _mapOfGlyphs.find(character);
+    
+    if (it != _mapOfGlyphs.end())
+        return &(*it).second;
+    
+    // Kept blank on errors, which are then reported only once
+    glyph = &_mapOfGlyphs[character];
+    memset(glyph, 0, sizeof(DGGlyph));
+    glyph->index = FT_Get_Char_Index(_face, character);
+    glyph->page = -1;
+    
+    if (FT_Load_Glyph(_face, glyph->index, FT_LOAD_DEFAULT)) {
+        log->error(DGModFont, "%s: %d", DGMsg260005, character);
+        return glyph;
+    }
+    
+    if (FT_Get_Glyph(_face->glyph, &ftGlyph)) {
+        log->error(DGModFont, "%s: %d", DGMsg260006, character);
+        return glyph;
+    }
+    
+    // Test code to define a stroke
+    /*FT_Stroker stroker = NULL;
+    FT_Stroker_New(*_library, &stroker);
+    FT_Stroker_Set(stroker, 32, 
+                   FT_STROKER_LINECAP_BUTT, 
+                   FT_STROKER_LINEJOIN_MITER, 
+                   0);
+    FT_Glyph_Stroke(&ftGlyph, stroker, 1);
+    FT_Stroker_Done(stroker);*/
+    
+    FT_Glyph_To_Bitmap(&ftGlyph, ft_render_mode_normal, 0, 1);
+    bitmapGlyph = (FT_BitmapGlyph)ftGlyph;
+    
+    glyph->width = bitmapGlyph->bitmap.width;
+    glyph->rows = bitmapGlyph->bitmap.rows;
+    glyph->left = bitmapGlyph->left;
+    glyph->top = bitmapGlyph->top;
+    glyph->advance = _face->glyph->advance.x;
+    
+    _placeGlyph(&bitmapGlyph->bitmap, glyph);
+    
+    FT_Done_Glyph(ftGlyph);
+    
+    return glyph;
+}
+
+int DGFont::_kerning(FT_UInt previous, FT_UInt next) {
+    FT_Vector delta;
+    
+    if (!_hasKerning || !previous || !next)
+        return 0;
+    
+    FT_Get_Kerning(_face, previous, next, FT_KERNING_DEFAULT, &delta);
+    
+    return delta.x >> 6;
+}
+
+void DGFont::_layout(const char* text) {
+    _stamp++;
+    _arrayOfLine.clear();
+    
+    // Pages drawn from are stamped, so none is cleared until the line is done
+    while (*text) {
+        DGGlyph* glyph = _glyph(DGNextCharacter(&text));
+        
+        if (glyph->page >= 0)
+            _arrayOfPages[glyph->page].lastUse = _stamp;
+        
+        _arrayOfLine.push_back(glyph);
+    }
+}
+
 void DGFont::_loadFont() {
-    unsigned char ch;
+    int area;
     
     FT_Set_Char_Size(_face, _height << 6, _height << 6, 96, 96);
+    _hasKerning = FT_HAS_KERNING(_face);
     
-    _textures = (GLuint*)malloc(128 * sizeof(GLuint));
-	glGenTextures(128, _textures);
-	
-	for (ch = 0; ch < 128; ch++) {
-		int width, height;
-		float x, y;
-        
-        FT_Bitmap bitmap;
-        FT_BitmapGlyph bitmapGlyph;
-		FT_Glyph glyph;
-		GLubyte* expandedData;
-		
-		if (FT_Load_Glyph(_face, FT_Get_Char_Index(_face, ch), FT_LOAD_DEFAULT)) {
-			log->error(DGModFont, "%s: %c", DGMsg260005, ch);
-            return;
+    // Enough room for the ASCII glyphs as large as the widest one
+    area = 128 * ((_face->size->metrics.height >> 6) + DGFontGlyphBorder) *
+        ((_face->size->metrics.max_advance >> 6) + DGFontGlyphBorder);
+    
+    _pageSize = _next((int)sqrtf((float)area));
+    if (_pageSize > DGFontMaxPageSize)
+        _pageSize = DGFontMaxPageSize;
+    
+    // Pages are created with the first glyphs in them
+}
+
+void DGFont::_newPage() {
+    DGFontPage page;
+    
+    // Once there are enough pages, take the one drawn least recently
+    if (_arrayOfPages.size() >= DGFontMaxPages) {
+        int oldest = -1;
+        
+        for (int i = 0; i < (int)_arrayOfPages.size(); i++) {
+            if (_arrayOfPages[i].lastUse != _stamp &&
+                (oldest < 0 || _arrayOfPages[i].lastUse < _arrayOfPages[oldest].lastUse))
+                oldest = i;
         }
-		
-		if (FT_Get_Glyph(_face->glyph, &glyph)) {
-			log->error(DGModFont, "%s: %c", DGMsg260006, ch);
+        
+        if (oldest >= 0) {
+            _clearPage(oldest);
+            _currentPage = oldest;
             return;
         }
         
-        // Test code to define a stroke
-        /*FT_Stroker stroker = NULL;
-        FT_Stroker_New(*_library, &stroker);
-        FT_Stroker_Set(stroker, 32, 
-                       FT_STROKER_LINECAP_BUTT, 
-                       FT_STROKER_LINEJOIN_MITER, 
-                       0);
-        FT_Glyph_Stroke(&glyph, stroker, 1);
-		FT_Stroker_Done(stroker);*/
-        
-		FT_Glyph_To_Bitmap(&glyph, ft_render_mode_normal, 0, 1);
-		bitmapGlyph = (FT_BitmapGlyph)glyph;
-		
-		bitmap = bitmapGlyph->bitmap;
-		
-		width = _next(bitmap.width);
-		height = _next(bitmap.rows);
-		
-		expandedData = (GLubyte*)malloc(2 * width * height); // Is there a sizeof() missing here?
-		
-		for (int j = 0; j < height; j++) {
-			for (int i = 0; i < width; i++) {
-				expandedData[2 * (i + j * width)] = expandedData[2 * (i + j * width) + 1] = 
-				(i >= bitmap.width || j >= bitmap.rows) ?
-				0 : bitmap.buffer[i + bitmap.width * j];
-			}
-		}
-		
-		x = (float)bitmap.width / (float)width;
-		y = (float)bitmap.rows / (float)height;
-		
-		_glyph[ch].x = x; 
-		_glyph[ch].y = y;
-		_glyph[ch].width = bitmap.width;
-		_glyph[ch].rows = bitmap.rows;
-		_glyph[ch].left = bitmapGlyph->left;
-		_glyph[ch].top = bitmapGlyph->top;
-		_glyph[ch].advance = _face->glyph->advance.x;
-		
-		glBindTexture(GL_TEXTURE_2D, _textures[ch]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-		
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height,
-					 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, expandedData);
-		
-		free(expandedData);
-	}
+        // Otherwise the line being drawn needs them all, so we add
+        // one that goes once the line is done
+    }
+    
+    glGenTextures(1, &page.texture);
+    glBindTexture(GL_TEXTURE_2D, page.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, _pageSize, _pageSize,
+                 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, NULL);
+    
+    _arrayOfPages.push_back(page);
+    _currentPage = _arrayOfPages.size() - 1;
+    _clearPage(_currentPage);
 }
 
 int DGFont::_next(int a) {
@@ -242,3 +393,79 @@ int DGFont::_next(int a) {
     while (rval < a) rval <<= 1;
     return rval;
 }
+
+// Pages added beyond the limit by a single line, always the last ones
+void DGFont::_trimPages() {
+    while (_arrayOfPages.size() > DGFontMaxPages) {
+        int last = (int)_arrayOfPages.size() - 1;
+        
+        _dropGlyphs(last);
+        glDeleteTextures(1, &_arrayOfPages[last].texture);
+        _arrayOfPages.pop_back();
+        
+        if (_currentPage == last)
+            _currentPage = last - 1;
+    }
+}
+
+void DGFont::_placeGlyph(FT_Bitmap* bitmap, DGGlyph* glyph) {
+    int width = bitmap->width + DGFontGlyphBorder;
+    int height = bitmap->rows + DGFontGlyphBorder;
+    DGFontPage* page;
+    GLubyte* expandedData;
+    
+    // Blanks take no room
+    if (!bitmap->width || !bitmap->rows)
+        return;
+    
+    if (width > _pageSize || height > _pageSize) {
+        glyph->width = 0;
+        return;
+    }
+    
+    if (_arrayOfPages.empty())
+        _newPage();
+    
+    // Start a new row when this one is full, and a new page after the last row
+    page = &_arrayOfPages[_currentPage];
+    
+    if ((page->penX + width) > _pageSize) {
+        page->penX = 0;
+        page->penY += page->rowHeight;
+        page->rowHeight = 0;
+    }
+    
+    if ((page->penY + height) > _pageSize) {
+        _newPage();
+        page = &_arrayOfPages[_currentPage];
+    }
+    
+    expandedData = (GLubyte*)malloc(2 * bitmap->width * bitmap->rows);
+    
+    for (int j = 0; j < (int)bitmap->rows; j++) {
+        for (int i = 0; i < (int)bitmap->width; i++) {
+            expandedData[2 * (i + j * bitmap->width)] = expandedData[2 * (i + j * bitmap->width) + 1] =
+            bitmap->buffer[i + bitmap->pitch * j];
+        }
+    }
+    
+    // Rows of glyphs are seldom aligned
+    glBindTexture(GL_TEXTURE_2D, page->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, page->penX, page->penY, bitmap->width, bitmap->rows,
+                    GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, expandedData);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    textureManager->chargeUpload(2 * bitmap->width * bitmap->rows);
+    
+    free(expandedData);
+    
+    glyph->page = _currentPage;
+    glyph->texCoords[0] = (float)page->penX / (float)_pageSize;
+    glyph->texCoords[1] = (float)page->penY / (float)_pageSize;
+    glyph->texCoords[2] = (float)(page->penX + bitmap->width) / (float)_pageSize;
+    glyph->texCoords[3] = (float)(page->penY + bitmap->rows) / (float)_pageSize;
+    
+    page->penX += width;
+    if (height > page->rowHeight)
+        page->rowHeight = height;
+}
@@ -17,6 +17,8 @@
 // Headers
 ////////////////////////////////////////////////////////////
 
+#include <map>
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
@@ -29,16 +31,88 @@
 // Definitions
 ////////////////////////////////////////////////////////////
 
+// Glyphs are rendered the first time they are needed, and packed in rows
+// on a few pages, each large enough for the ASCII glyphs of the font. Once
+// every page is full, the one least recently drawn is cleared for reuse.
+#define DGFontGlyphBorder   1
+#define DGFontMaxPages      4
+#define DGFontMaxPageSize   1024
+
+// Stands for sequences that aren't valid UTF-8
+#define DGFontUnknownCharacter  0xFFFD
+
 // This structure holds information from the Freetype font
 typedef struct {
-	float x;
-	float y;
+	FT_UInt index; // In the face, to look up the kerning
+	int page; // Negative if blank
+	float texCoords[4]; // Left, top, right and bottom in the page
 	int width;
 	int rows;
 	int left;
 	int top;
 	long advance;
 } DGGlyph;
+
+typedef struct {
+    GLuint texture;
+    int penX; // Where the next glyph goes
+    int penY;
+    int rowHeight;
+    unsigned int lastUse; // Of the line that last drew from it
+} DGFontPage;
+
+// Decodes the next character of UTF-8 text and moves past it
+inline uint32_t DGNextCharacter(const char** text) {
+    const unsigned char* c = (const unsigned char*)*text;
+    uint32_t character;
+    int length;
+    
+    if (*c < 0x80) {
+        character = *c;
+        length = 1;
+    }
+    else if ((*c & 0xE0) == 0xC0) {
+        character = *c & 0x1F;
+        length = 2;
+    }
+    else if ((*c & 0xF0) == 0xE0) {
+        character = *c & 0x0F;
+        length = 3;
+    }
+    else if ((*c & 0xF8) == 0xF0) {
+        character = *c & 0x07;
+        length = 4;
+    }
+    else {
+        (*text)++;
+        return DGFontUnknownCharacter;
+    }
+    
+    for (int i = 1; i < length; i++) {
+        // Cut short, so resume from the following byte
+        if ((c[i] & 0xC0) != 0x80) {
+            *text += i;
+            return DGFontUnknownCharacter;
+        }
+        
+        character = (character << 6) | (c[i] & 0x3F);
+    }
+    
+    *text += length;
+    
+    return character;
+}
+
+inline size_t DGCountCharacters(const char* text) {
+    size_t count = 0;
+    
+    while (*text) {
+        DGNextCharacter(&text);
+        count++;
+    }
+    
+    return count;
+}
  
 // When default font is selected, we use data embedded in the
 // executable and declared in DGFontData.c
@@ -46,6 +120,7 @@ extern "C" const unsigned char DGDefFontBinary[];
 
 class DGConfig;
 class DGLog;
+class DGTextureManager;
 
 ////////////////////////////////////////////////////////////
 // Interface
@@ -54,16 +129,32 @@ class DGLog;
 class DGFont : public DGObject {
     DGConfig* config;
     DGLog* log;
+    DGTextureManager* textureManager;
     
     FT_Face _face;
-    DGGlyph _glyph[128];
+    bool _hasKerning;
     int _height;
     bool _isLoaded;
     FT_Library* _library;
-	GLuint* _textures;
     
+    std::map<uint32_t, DGGlyph> _mapOfGlyphs; // Only those used so far
+    std::vector<DGFontPage> _arrayOfPages;
+    std::vector<DGGlyph*> _arrayOfLine; // Glyphs of the line being drawn
+    std::vector<GLfloat> _arrayOfVertices; // Reused by every print
+    int _currentPage; // Where glyphs are placed
+    int _pageSize;
+    unsigned int _stamp; // Of the line being drawn
+    
+    void _clearPage(int page);
+    void _dropGlyphs(int page);
+    DGGlyph* _glyph(uint32_t character);
+    int _kerning(FT_UInt previous, FT_UInt next); // In pixels
+    void _layout(const char* text); // Glyphs of the text, in their pages
     void _loadFont();
+    void _newPage();
     int _next(int a);
+    void _placeGlyph(FT_Bitmap* bitmap, DGGlyph* glyph);
+    void _trimPages(); // Back to DGFontMaxPages once a line is done
     
 public:
     DGFont();
@@ -71,11 +162,13 @@ public:
 
     void clear();
     bool isLoaded();
+    void preload(const char* text); // Renders the glyphs of text in advance
     void print(int x, int y, const char* text, ...);
     void setColor(int color);
     void setDefault(unsigned int heightOfFont);
     void setLibrary(FT_Library* library);
     void setResource(const char* fromFileName, unsigned int heightOfFont);
+    int width(const char* text); // In pixels, as printed
 };
 
 #endif // DG_FONT_H
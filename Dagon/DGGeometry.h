@@ -36,4 +36,68 @@ typedef struct {
 
 // Add functions to make point, size, etc.
 
+// Returns the point in space of a position in a face of the cube, given
+// from 0 to 1 starting at the top left corner. Faces are ordered as
+// directions and laid out as the Render Manager draws them.
+static inline DGVector DGMakeFacePoint(int face, double u, double v) {
+    static const double corners[6][9] = {
+        {-1.0,  1.0, -1.0,   1.0,  1.0, -1.0,  -1.0, -1.0, -1.0}, // North
+        { 1.0,  1.0, -1.0,   1.0,  1.0,  1.0,   1.0, -1.0, -1.0}, // East
+        { 1.0,  1.0,  1.0,  -1.0,  1.0,  1.0,   1.0, -1.0,  1.0}, // South
+        {-1.0,  1.0,  1.0,  -1.0,  1.0, -1.0,  -1.0, -1.0,  1.0}, // West
+        {-1.0,  1.0,  1.0,   1.0,  1.0,  1.0,  -1.0,  1.0, -1.0}, // Up
+        {-1.0, -1.0, -1.0,   1.0, -1.0, -1.0,  -1.0, -1.0,  1.0}  // Down
+    };
+    
+    // Top left corner, then the top right and bottom left ones
+    const double* c = corners[face];
+    DGVector point;
+    
+    point.x = c[0] + (u * (c[3] - c[0])) + (v * (c[6] - c[0]));
+    point.y = c[1] + (u * (c[4] - c[1])) + (v * (c[7] - c[1]));
+    point.z = c[2] + (u * (c[5] - c[2])) + (v * (c[8] - c[2]));
+    
+    return point;
+}
+
+// The inverse of DGMakeFacePoint(), where the given ray crosses the plane
+// of a face, which may be beyond its edges. Returns false if the plane is
+// behind the ray or parallel to it.
+static inline bool DGIntersectFace(int face, DGVector origin, DGVector direction, double* u, double* v) {
+    DGVector corner = DGMakeFacePoint(face, 0.0, 0.0);
+    DGVector right = DGMakeFacePoint(face, 1.0, 0.0);
+    DGVector down = DGMakeFacePoint(face, 0.0, 1.0);
+    DGVector normal, point;
+    double distance, t;
+    
+    right.x -= corner.x; right.y -= corner.y; right.z -= corner.z;
+    down.x -= corner.x; down.y -= corner.y; down.z -= corner.z;
+    
+    normal.x = (right.y * down.z) - (right.z * down.y);
+    normal.y = (right.z * down.x) - (right.x * down.z);
+    normal.z = (right.x * down.y) - (right.y * down.x);
+    
+    distance = (direction.x * normal.x) + (direction.y * normal.y) + (direction.z * normal.z);
+    
+    if (distance == 0.0)
+        return false;
+    
+    t = (((corner.x - origin.x) * normal.x) + ((corner.y - origin.y) * normal.y) +
+         ((corner.z - origin.z) * normal.z)) / distance;
+    
+    if (t <= 0.0)
+        return false;
+    
+    point.x = origin.x + (t * direction.x) - corner.x;
+    point.y = origin.y + (t * direction.y) - corner.y;
+    point.z = origin.z + (t * direction.z) - corner.z;
+    
+    *u = ((point.x * right.x) + (point.y * right.y) + (point.z * right.z)) /
+         ((right.x * right.x) + (right.y * right.y) + (right.z * right.z));
+    *v = ((point.x * down.x) + (point.y * down.y) + (point.z * down.z)) /
+         ((down.x * down.x) + (down.y * down.y) + (down.z * down.z));
+    
+    return true;
+}
+
 #endif // DG_GEOMETRY_H
@@ -17,6 +17,7 @@
 #include "DGConfig.h"
 #include "DGImage.h"
 #include "DGTexture.h"
+#include "DGTextureManager.h"
 
 ////////////////////////////////////////////////////////////
 // Implementation - Constructor
@@ -24,6 +25,7 @@
 
 DGImage::DGImage() {
     config = &DGConfig::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     
     _rect.origin.x = 0;
     _rect.origin.y = 0; 
@@ -37,17 +39,20 @@ DGImage::DGImage() {
 
 DGImage::DGImage(const char* fromFileName) {
     config = &DGConfig::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     
+    _rect.origin.x = 0;
+    _rect.origin.y = 0; 
+    _rect.size.width = 0;
+    _rect.size.height = 0;
+    
+    // The size is known once decoded, even if large images are uploaded later,
+    // and the texture may be a page shared with other images
     this->setTexture(fromFileName);
-    if (_attachedTexture->isLoaded()) {
-        _rect.origin.x = 0;
-        _rect.origin.y = 0; 
-        
-        _rect.size.width = _attachedTexture->width();
-        _rect.size.height = _attachedTexture->height();
-        
-        _calculateCoordinates();
-    }
+    if (_textureSize.width && _textureSize.height)
+        _rect.size = _textureSize;
+    
+    _calculateCoordinates();
     
     this->setType(DGObjectImage);    
 }
@@ -92,6 +97,10 @@ float* DGImage::arrayOfCoordinates() {
     return _arrayOfCoordinates;
 }
 
+float* DGImage::arrayOfTexCoords() {
+    return _arrayOfTexCoords;
+}
+
 void DGImage::move(float offsetX, float offsetY) {
     _rect.origin.x += offsetX;
     _rect.origin.y += offsetY;
@@ -125,16 +134,9 @@ void DGImage::setSize(float width, float height) {
 }
 
 void DGImage::setTexture(const char* fromFileName) {
-    // TODO: Important! Should determine first if the texture already exists,
-    // to avoid repeating resources. Eventually, this would be done with the
-    // resource manager.
-    DGTexture* texture;
-    
-    texture = new DGTexture;
-    texture->setResource(config->path(DGPathRes, fromFileName, DGObjectImage));
-    texture->load();
-    
-    _attachedTexture = texture;
+    // Small images are packed together, and repeated ones are shared
+    _attachedTexture = textureManager->requestImage(config->path(DGPathRes, fromFileName, DGObjectImage),
+                                                    _arrayOfTexCoords, &_textureSize);
     _hasTexture = true;
 }
 
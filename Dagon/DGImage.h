@@ -25,6 +25,7 @@
 
 class DGConfig;
 class DGTexture;
+class DGTextureManager;
 
 ////////////////////////////////////////////////////////////
 // Interface
@@ -32,11 +33,14 @@ class DGTexture;
 
 class DGImage : public DGObject {
     DGConfig* config;
+    DGTextureManager* textureManager;
     
-    DGTexture* _attachedTexture;
+    DGTexture* _attachedTexture; // May be shared with other images
     float _arrayOfCoordinates[8];
+    float _arrayOfTexCoords[8];
     bool _hasTexture;
     DGRect _rect;
+    DGSize _textureSize;
     
     void _calculateCoordinates();
     
@@ -52,6 +56,7 @@ public:
     // Gets
     
     float* arrayOfCoordinates();
+    float* arrayOfTexCoords(); // Of the image in its texture
     DGPoint position();
     DGSize size();
     DGTexture* texture();
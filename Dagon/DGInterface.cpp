@@ -61,40 +61,34 @@ void DGInterface::drawCursor() {
     if (cursorManager->isEnabled()) {
         if (cursorManager->hasImage()) { // A bitmap cursor is currently set
             cursorManager->updateFade(); // Process fade (supported only with bitmaps)
-            cursorManager->bindImage();
-            renderManager->setAlpha(cursorManager->fadeLevel());
-            renderManager->drawSlide(cursorManager->arrayOfCoords());
+            renderManager->drawSprite(cursorManager->image(), cursorManager->arrayOfCoords(), cursorManager->arrayOfTexCoords(),
+                                      DGColorWhite, cursorManager->fadeLevel(), DGSpriteLayerCursor);
         }
         else {
             DGPoint position = cursorManager->position();
             
-            renderManager->disableTextures(); // Default cursor doesn't require textures
+            // Default cursor doesn't require textures
             if (cursorManager->onButton() || cursorManager->hasAction())
-                renderManager->setColor(DGColorBrightRed);
+                renderManager->drawHelper(position.x, position.y, DGColorBrightRed, false);
             else
-                renderManager->setColor(DGColorDarkGray);
-            renderManager->drawHelper(position.x, position.y, false);
-            renderManager->enableTextures();
+                renderManager->drawHelper(position.x, position.y, DGColorDarkGray, false);
         }
+        
+        renderManager->flushSprites();
     }
 }
 
 void DGInterface::drawHelpers() {
-    renderManager->disableTextures();
-    
-    // Helpers
+    // Helpers, drawn along with the overlays
     if (config->showHelpers) {
         if (renderManager->beginIteratingHelpers()) { // Check if we have any
             do {
                 DGPoint point = renderManager->currentHelper();
-                renderManager->setColor(DGColorBrightCyan);
-                renderManager->drawHelper(point.x, point.y, true);
+                renderManager->drawHelper(point.x, point.y, DGColorBrightCyan, true);
                 
             } while (renderManager->iterateHelpers());
         }
     }
-    
-    renderManager->enableTextures();
 }
 
 void DGInterface::drawOverlays() {
@@ -115,14 +109,15 @@ void DGInterface::drawOverlays() {
                         if (button->isEnabled()) {
                             button->updateFade();
                             
-                            if (button->hasTexture()) {
-                                renderManager->setAlpha(button->fadeLevel());
-                                button->texture()->bind();
-                                renderManager->drawSlide(button->arrayOfCoordinates());
+                            // Images are drawn once uploaded
+                            if (button->hasTexture() && button->texture()->isLoaded()) {
+                                renderManager->drawSprite(button->texture(), button->arrayOfCoordinates(), button->arrayOfTexCoords(),
+                                                          DGColorWhite, button->fadeLevel());
                             }
                             
                             if (button->hasText()) {
                                 DGPoint position = button->position();
+                                renderManager->flushSprites(); // Text goes over what was queued
                                // int color = button->textColor();
                                 if (button->isFading())
                                     renderManager->setColor(button->textColor(), button->fadeLevel());
@@ -145,9 +140,11 @@ void DGInterface::drawOverlays() {
                         DGImage* image = (*itOverlay)->currentImage();
                         if (image->isEnabled()) {
                             image->updateFade(); // Perform any necessary updates
-                            image->texture()->bind();
-                            renderManager->setAlpha(image->fadeLevel());
-                            renderManager->drawSlide(image->arrayOfCoordinates());
+                            
+                            if (image->texture()->isLoaded()) {
+                                renderManager->drawSprite(image->texture(), image->arrayOfCoordinates(), image->arrayOfTexCoords(),
+                                                          DGColorWhite, image->fadeLevel());
+                            }
                         }
                     } while ((*itOverlay)->iterateImages());
                 }
@@ -156,7 +153,9 @@ void DGInterface::drawOverlays() {
             
             itOverlay++;
         }
-    }   
+    }
+    
+    renderManager->flushSprites();
 }
 
 bool DGInterface::scanOverlays() {
@@ -49,6 +49,8 @@
 #define DGMsg210002	"Error while loading compressed image"
 #define DGMsg210003	"Unsupported number of channels in image"
 #define DGMsg210004	"No resource found for texture"
+#define DGMsg210005	"Damaged chunk in packed texture"
+#define DGMsg210006	"Unsupported compression level in texture"
 
 // Render module
 #define DGMsg020000 "Initializing renderer..."
@@ -96,6 +98,7 @@
 #define DGMsg250010 "Syntax error"
 #define DGMsg250011 "Function expected as second parameter in register()"
 #define DGMsg250012 "Bad configuration file"
+#define DGMsg250013 "Function expected to report the progress of preload()"
 
 // Font module
 #define DGMsg060000 "Initializing font manager..."
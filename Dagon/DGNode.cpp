@@ -25,9 +25,12 @@ using namespace std;
 ////////////////////////////////////////////////////////////
 
 DGNode::DGNode() {
+    _cubeMap = NULL;
     _hasBundleName = false;
     _isSlide = false;
     _slideReturn = 0;
+    _spotBuffer = NULL;
+    _tileSet = NULL;
     
     this->setType(DGObjectNode);
 }
@@ -58,12 +61,20 @@ bool DGNode::hasBundleName() {
     return _hasBundleName;
 }
 
+bool DGNode::hasCubeMap() {
+    return (_cubeMap != NULL);
+}
+
 bool DGNode::hasSpots() {
     // This should never happen but we check it anyway to
     // avoid any crashes
     return !_arrayOfSpots.empty();
 }
 
+bool DGNode::hasTileSet() {
+    return (_tileSet != NULL);
+}
+
 bool DGNode::isSlide() {
     return _isSlide;
 }
@@ -72,6 +83,14 @@ int DGNode::slideReturn() {
     return _slideReturn;
 }
 
+DGSpotBuffer* DGNode::spotBuffer() {
+    return _spotBuffer;
+}
+
+DGTileSet* DGNode::tileSet() {
+    return _tileSet;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - Gets
 ////////////////////////////////////////////////////////////
@@ -84,6 +103,10 @@ char* DGNode::bundleName() {
     return _bundleName;
 }
 
+DGTexture* DGNode::cubeMap() {
+    return _cubeMap;
+}
+
 const char* DGNode::description() {
     return _description.c_str();
 }
@@ -101,6 +124,10 @@ void DGNode::setBundleName(const char* name) {
     _hasBundleName = true;
 }
 
+void DGNode::setCubeMap(DGTexture* texture) {
+    _cubeMap = texture;
+}
+
 void DGNode::setDescription(const char* description) {
     _description = description;
 }
@@ -117,6 +144,14 @@ void DGNode::setSlideReturn(int luaHandler) {
     _slideReturn = luaHandler;
 }
 
+void DGNode::setSpotBuffer(DGSpotBuffer* spotBuffer) {
+    _spotBuffer = spotBuffer;
+}
+
+void DGNode::setTileSet(DGTileSet* tileSet) {
+    _tileSet = tileSet;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - State changes
 ////////////////////////////////////////////////////////////
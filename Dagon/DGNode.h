@@ -25,6 +25,9 @@
 ////////////////////////////////////////////////////////////
 
 class DGSpot;
+class DGTexture;
+struct DGSpotBuffer;
+struct DGTileSet;
 
 ////////////////////////////////////////////////////////////
 // Interface
@@ -36,10 +39,13 @@ class DGNode : public DGObject {
     // filename. This would be the name of the Lua object.
     
     char _bundleName[DGMaxObjectName];
+    DGTexture* _cubeMap; // All six faces in a single texture
     bool _hasBundleName;
     DGNode* _previousNode;
     bool _isSlide;
     int _slideReturn;
+    DGSpotBuffer* _spotBuffer; // Geometry of the spots, owned by the Render Manager
+    DGTileSet* _tileSet; // Faces streamed in tiles, owned by the Texture Manager
     
     std::vector<DGSpot*> _arrayOfSpots;
     std::vector<DGSpot*>::iterator _it;
@@ -56,24 +62,32 @@ public:
     // Checks
     
     bool hasBundleName();
+    bool hasCubeMap();
     bool hasSpots();
+    bool hasTileSet();
     bool isSlide();
     
     // Gets
     
     char* bundleName();
+    DGTexture* cubeMap();
     const char* description();
     DGSpot* currentSpot();
     DGNode* previousNode();
     int slideReturn();
+    DGSpotBuffer* spotBuffer();
+    DGTileSet* tileSet();
     
     // Sets
     
     void setBundleName(const char* name);
+    void setCubeMap(DGTexture* texture);
     void setDescription(const char* description);
     void setPreviousNode(DGNode* node);
     void setSlide(bool enabled);
     void setSlideReturn(int luaHandler);
+    void setSpotBuffer(DGSpotBuffer* spotBuffer);
+    void setTileSet(DGTileSet* tileSet);
     
     // State changes
     
@@ -14,10 +14,14 @@
 // Headers
 ////////////////////////////////////////////////////////////
 
+#include <cstddef>
+
 #include "DGConfig.h"
 #include "DGEffectsManager.h"
 #include "DGLog.h"
+#include "DGNode.h"
 #include "DGRenderManager.h"
+#include "DGSpot.h"
 #include "DGTexture.h"
 
 using namespace std;
@@ -35,6 +39,8 @@ DGRenderManager::DGRenderManager() {
     _fadeTexture = NULL;
     _fadeWithZoom = false;
     _helperLoop = 0.0f;
+    _spotBuffer = NULL;
+    _spriteBuffer = 0;
     
     _blendNextUpdate = false;
 	_texturesEnabled = false;
@@ -50,6 +56,25 @@ DGRenderManager::~DGRenderManager() {
     
     if (_fadeTexture)
         delete _fadeTexture;
+    
+    if (!_arrayOfSpotBuffers.empty()) {
+        vector<DGSpotBuffer*>::iterator it;
+        
+        it = _arrayOfSpotBuffers.begin();
+        
+        while (it != _arrayOfSpotBuffers.end()) {
+            if ((*it)->vertexBuffer) {
+                glDeleteBuffers(1, &(*it)->vertexBuffer);
+                glDeleteBuffers(1, &(*it)->indexBuffer);
+            }
+            
+            delete *it;
+            it++;
+        }
+    }
+    
+    if (_spriteBuffer)
+        glDeleteBuffers(1, &_spriteBuffer);
 }
 
 ////////////////////////////////////////////////////////////
@@ -115,6 +140,14 @@ void DGRenderManager::init() {
     
     glEnableClientState(GL_VERTEX_ARRAY);
     
+    // Sprites are streamed into a buffer if supported, else from their array
+    if (GLEW_VERSION_1_5)
+        glGenBuffers(1, &_spriteBuffer);
+    
+    // Filter across the edges of cube maps, so that faces show no seams
+    if (GLEW_ARB_seamless_cube_map)
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+    
     if (config->framebuffer)
         _initFrameBuffer();
 }
@@ -203,6 +236,36 @@ DGVector DGRenderManager::unProject(int x, int y) {
     return vector;
 }
 
+void DGRenderManager::unProjectRay(int x, int y, DGVector* origin, DGVector* direction) {
+    GLdouble nearX, nearY, nearZ;
+    GLdouble farX, farY, farZ;
+    
+    GLdouble modelView[16];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelView);
+    
+    GLdouble projection[16];
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    
+    // Note we flip the Y coordinate, as in project()
+    gluUnProject((GLdouble)x, (GLdouble)(config->displayHeight - y), 0.0,
+                 modelView, projection, viewport,
+                 &nearX, &nearY, &nearZ);
+    gluUnProject((GLdouble)x, (GLdouble)(config->displayHeight - y), 1.0,
+                 modelView, projection, viewport,
+                 &farX, &farY, &farZ);
+    
+    origin->x = nearX;
+    origin->y = nearY;
+    origin->z = nearZ;
+    
+    direction->x = farX - nearX;
+    direction->y = farY - nearY;
+    direction->z = farZ - nearZ;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - Drawing operations
 ////////////////////////////////////////////////////////////
@@ -245,173 +308,102 @@ void DGRenderManager::disableTextures() {
     }
 }
 
-void DGRenderManager::drawHelper(int xPosition, int yPosition, bool animate) {
-    glDisable(GL_LINE_SMOOTH);
-    
-    // TODO: Test later if push & pop is necessary at this point
-	glPushMatrix();
-	glTranslatef(xPosition, yPosition, 0);
-    
-    if (animate) {
-        GLfloat currColor[4];
-        glGetFloatv(GL_CURRENT_COLOR, currColor);
-        glColor4f(currColor[0], currColor[1], currColor[2], 1.0f - _helperLoop);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glScalef(1.0f * (_helperLoop * 2.0f), 1.0f * (_helperLoop * 2.0f), 0);   
-    }
-    else {
-        glScalef(1.0f, 1.1f, 0);
-        glBlendFunc(GL_ONE, GL_ONE);
+void DGRenderManager::beginSpots(DGNode* node) {
+    DGSpotBuffer* spotBuffer = node->spotBuffer();
+    bool hasChanged = false;
+    unsigned int numSpots = 0;
+    
+    if (!spotBuffer) {
+        spotBuffer = new DGSpotBuffer;
+        spotBuffer->vertexBuffer = 0;
+        spotBuffer->indexBuffer = 0;
+        
+        if (GLEW_VERSION_1_5) {
+            glGenBuffers(1, &spotBuffer->vertexBuffer);
+            glGenBuffers(1, &spotBuffer->indexBuffer);
+        }
+        
+        _arrayOfSpotBuffers.push_back(spotBuffer);
+        node->setSpotBuffer(spotBuffer);
+        hasChanged = true;
     }
     
-	glVertexPointer(2, GL_FLOAT, 0, _defCursor);
-	
-	glDrawArrays(GL_LINE_LOOP, 0, (DGDefCursorDetail / 2) + 2);
+    if (node->hasSpots()) {
+        node->beginIteratingSpots();
+        do {
+            if ((numSpots >= spotBuffer->arrayOfRanges.size()) ||
+                (spotBuffer->arrayOfRanges[numSpots].revision != node->currentSpot()->revision()))
+                hasChanged = true;
+            
+            numSpots++;
+        } while (node->iterateSpots());
+    }
     
-	if (animate) glScalef(0.85f * _helperLoop, 0.85f * _helperLoop, 0);
-    else glScalef(0.835f, 0.85f, 0);
-	glDrawArrays(GL_TRIANGLE_FAN, 0, (DGDefCursorDetail / 2) + 2);
-	glPopMatrix();
+    if (hasChanged || (numSpots != spotBuffer->arrayOfRanges.size()))
+        _buildSpots(node, spotBuffer);
     
-	glEnable(GL_LINE_SMOOTH);
+    _spotBuffer = spotBuffer;
     
-    if (_alphaEnabled)
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    else 
-        glBlendFunc(GL_ONE, GL_ZERO);
+    if (spotBuffer->vertexBuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, spotBuffer->vertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spotBuffer->indexBuffer);
+        glVertexPointer(3, GL_FLOAT, 5 * sizeof(GLfloat), (GLvoid*)0);
+        glTexCoordPointer(2, GL_FLOAT, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+    }
+    else if (!spotBuffer->arrayOfVertices.empty()) {
+        glVertexPointer(3, GL_FLOAT, 5 * sizeof(GLfloat), &spotBuffer->arrayOfVertices[0]);
+        glTexCoordPointer(2, GL_FLOAT, 5 * sizeof(GLfloat), &spotBuffer->arrayOfVertices[3]);
+    }
 }
 
-void DGRenderManager::drawPolygon(vector<int> withArrayOfCoordinates, unsigned int onFace) {
-    const float x = 1.0f;
-	const float y = 1.0f;
-    
-    int i, j;
-    int cubeTextureSize = DGDefTexSize;
-    int sizeOfArray = (int)withArrayOfCoordinates.size();
-	int numCoords = sizeOfArray + (sizeOfArray / 2);
-	GLfloat* spotVertCoords = new GLfloat[numCoords];
-    
-	glPushMatrix();
-    
-	switch (onFace) {
-		case DGNorth:
-			glTranslatef(-x, y, -x);
-			for (i = 0, j = 0; i < sizeOfArray; i += 2, j += 3) {
-				spotVertCoords[j] = (GLfloat)withArrayOfCoordinates[i] / (GLfloat)(cubeTextureSize / 2); // Size is divided in half because of the way we draw the cube
-				spotVertCoords[j + 1] = (GLfloat)withArrayOfCoordinates[i + 1] / (GLfloat)(cubeTextureSize / 2) * -1; // We must invert the coordinates in some cases
-				spotVertCoords[j + 2] = 0.0f;
-			}
-			break;
-		case DGEast:
-			glTranslatef(x, y, -x);
-			for (i = 0, j = 0; i < sizeOfArray; i += 2, j += 3) {
-				spotVertCoords[j] = 0.0f;
-				spotVertCoords[j + 1] = (GLfloat)withArrayOfCoordinates[i + 1] / (GLfloat)(cubeTextureSize / 2) * -1;
-				spotVertCoords[j + 2] = (GLfloat)withArrayOfCoordinates[i] / (GLfloat)(cubeTextureSize / 2);               
-			}
-			break;
-		case DGSouth:
-			glTranslatef(x, y, x);
-			for (i = 0, j = 0; i < sizeOfArray; i += 2, j += 3) {
-				spotVertCoords[j] = (GLfloat)withArrayOfCoordinates[i] / (GLfloat)(cubeTextureSize / 2) * -1;
-				spotVertCoords[j + 1] = (GLfloat)withArrayOfCoordinates[i + 1] / (GLfloat)(cubeTextureSize / 2) * -1;
-				spotVertCoords[j + 2] = 0.0f;
-			}			
-			break;
-		case DGWest:
-			glTranslatef(-x, y, x);
-			for (i = 0, j = 0; i < sizeOfArray; i += 2, j += 3) {
-				spotVertCoords[j] = 0.0f;
-				spotVertCoords[j + 1] = (GLfloat)withArrayOfCoordinates[i + 1] / (GLfloat)(cubeTextureSize/ 2 ) * -1;
-				spotVertCoords[j + 2] = (GLfloat)withArrayOfCoordinates[i] / (GLfloat)(cubeTextureSize / 2) * -1;             
-			}
-			break;
-		case DGUp:
-			glTranslatef(-x, y, x);
-			for (i = 0, j = 0; i < sizeOfArray; i += 2, j += 3) {
-				spotVertCoords[j] = (GLfloat)withArrayOfCoordinates[i] / (GLfloat)(cubeTextureSize / 2);
-				spotVertCoords[j + 1] = 0.0f;
-				spotVertCoords[j + 2] = (GLfloat)withArrayOfCoordinates[i + 1] / (GLfloat)(cubeTextureSize / 2) * -1;
-			}
-			break;
-		case DGDown:
-			glTranslatef(-x, -y, -x);
-			for (i = 0, j = 0; i < sizeOfArray; i += 2, j += 3) {
-				spotVertCoords[j] = (GLfloat)withArrayOfCoordinates[i] / (GLfloat)(cubeTextureSize / 2);
-				spotVertCoords[j + 1] = 0.0f;
-				spotVertCoords[j + 2] = (GLfloat)withArrayOfCoordinates[i + 1] / (GLfloat)(cubeTextureSize / 2);
-			}
-			break;				
-	}
+void DGRenderManager::endSpots() {
+    // Other drawing operations read from client memory
+    if (_spotBuffer && _spotBuffer->vertexBuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
     
-	if (_texturesEnabled) {
-		float texU = (float)1 / (cubeTextureSize * 2);
-		float texV = (float)((cubeTextureSize * 2) - 1) / (cubeTextureSize * 2);
-        
-		GLfloat texCoords[] = {texU, texU, texV, texU, texV, texV, texU, texV};
-		glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
-	}
-    else {
-        // We can safely assume this spot has a color and therefore can use
-        // a "helper". Not the most elegant way to do this but, hey, it works.
-        DGPoint center = _centerOfPolygon(withArrayOfCoordinates);
-        
-        // This code is a bit redundant but optimal: the center is only calculated in
-        // the required cases. Basically, this projects the calculated point onto the
-        // corresponding face.
-        float x, y, z;
-        
-        switch (onFace) {
-            case DGNorth:
-                x = (GLfloat)center.x / (GLfloat)(cubeTextureSize / 2);
-                y = (GLfloat)center.y / (GLfloat)(cubeTextureSize / 2) * -1;
-                z = 0.0f;
-                break;
-            case DGEast:
-                x = 0.0f;
-                y = (GLfloat)center.y / (GLfloat)(cubeTextureSize / 2) * -1;                
-                z = (GLfloat)center.x / (GLfloat)(cubeTextureSize / 2);                  
-                break;
-            case DGSouth:
-                x = (GLfloat)center.x / (GLfloat)(cubeTextureSize / 2) * -1;
-				y = (GLfloat)center.y / (GLfloat)(cubeTextureSize / 2) * -1;
-				z = 0.0f;
-                break;
-            case DGWest:
-                x = 0.0f;
-                y = (GLfloat)center.y / (GLfloat)(cubeTextureSize / 2) * -1;                
-                z = (GLfloat)center.x / (GLfloat)(cubeTextureSize / 2) * -1;  
-                break;
-            case DGUp:
-                x = (GLfloat)center.x / (GLfloat)(cubeTextureSize / 2);
-                y = 0.0f;                
-                z = (GLfloat)center.y / (GLfloat)(cubeTextureSize / 2) * -1;
-                break;                 
-            case DGDown:
-                x = (GLfloat)center.x / (GLfloat)(cubeTextureSize / 2);
-                y = 0.0f;
-                z = (GLfloat)center.y / (GLfloat)(cubeTextureSize / 2);                
-                break;                
+    _spotBuffer = NULL;
+}
+
+void DGRenderManager::drawCubeMap() {
+    // Same layout as the faces of spots
+    static const GLfloat vertCoords[] = {
+        -1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,   1.0f, -1.0f, -1.0f,  -1.0f, -1.0f, -1.0f, // North
+         1.0f,  1.0f, -1.0f,   1.0f,  1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f, -1.0f, -1.0f, // East
+         1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f,  -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f, // South
+        -1.0f,  1.0f,  1.0f,  -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,  -1.0f, -1.0f,  1.0f, // West
+        -1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f, // Up
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, -1.0f,  1.0f,  -1.0f, -1.0f,  1.0f  // Down
+    };
+    
+    // The texture is addressed by direction, inverting Z so that our faces
+    // match the orientation of the cube map faces
+    static GLfloat texCoords[sizeof(vertCoords) / sizeof(GLfloat)];
+    static bool texCoordsReady = false;
+    
+    if (!texCoordsReady) {
+        for (unsigned int i = 0; i < sizeof(vertCoords) / sizeof(GLfloat); i += 3) {
+            texCoords[i] = vertCoords[i];
+            texCoords[i + 1] = vertCoords[i + 1];
+            texCoords[i + 2] = -vertCoords[i + 2];
         }
         
-        DGVector vector = this->project(x, y, z);
-        
-        if (vector.z < 1.0f) { // Only store coordinates on screen
-            DGPoint point;
-            
-            point.x = (int)vector.x;
-            point.y = (int)vector.y;  
-            
-            _arrayOfHelpers.push_back(point);
-        }
+        texCoordsReady = true;
     }
     
-	glVertexPointer(3, GL_FLOAT, 0, spotVertCoords);
-	glDrawArrays(GL_TRIANGLE_FAN, 0, sizeOfArray / 2);
+    if (!_texturesEnabled)
+        return;
     
-    delete spotVertCoords;
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_TEXTURE_CUBE_MAP);
     
-	glPopMatrix();
+    glTexCoordPointer(3, GL_FLOAT, 0, texCoords);
+    glVertexPointer(3, GL_FLOAT, 0, vertCoords);
+	glDrawArrays(GL_QUADS, 0, sizeof(vertCoords) / (sizeof(GLfloat) * 3));
+    
+    glDisable(GL_TEXTURE_CUBE_MAP);
+    glEnable(GL_TEXTURE_2D);
 }
 
 void DGRenderManager::drawPostprocessedView() {
@@ -436,12 +428,17 @@ void DGRenderManager::drawPostprocessedView() {
     }
 }
 
-void DGRenderManager::drawSlide(float* withArrayOfCoordinates) {
+void DGRenderManager::drawSlide(float* withArrayOfCoordinates, float* withArrayOfTexCoords) {
     glPushMatrix();
     
 	if (_texturesEnabled) {
-		GLfloat texCoords[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
-		glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+		static GLfloat texCoords[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+        
+        // Images in an atlas have their own coordinates
+        if (withArrayOfTexCoords)
+            glTexCoordPointer(2, GL_FLOAT, 0, withArrayOfTexCoords);
+        else
+            glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
 	}
     
 	glVertexPointer(2, GL_FLOAT, 0, withArrayOfCoordinates);
@@ -450,6 +447,44 @@ void DGRenderManager::drawSlide(float* withArrayOfCoordinates) {
 	glPopMatrix();
 }
 
+void DGRenderManager::drawSpot(int index) {
+    DGSpotRange* range = &_spotBuffer->arrayOfRanges[index];
+    
+    // Spots with nothing but an origin wait until they are resized
+    if (!range->numIndices)
+        return;
+    
+    if (_spotBuffer->indexBuffer)
+        glDrawElements(GL_TRIANGLES, range->numIndices, GL_UNSIGNED_SHORT,
+                       (GLvoid*)(range->firstIndex * sizeof(GLushort)));
+    else
+        glDrawElements(GL_TRIANGLES, range->numIndices, GL_UNSIGNED_SHORT,
+                       &_spotBuffer->arrayOfIndices[range->firstIndex]);
+}
+
+void DGRenderManager::drawTile(unsigned int onFace, float* withArrayOfCoordinates) {
+    GLfloat vertCoords[12];
+    
+    // Corners in the same order as the texture coordinates of slides
+    for (int i = 0; i < 4; i++) {
+        float u = withArrayOfCoordinates[((i == 1) || (i == 2)) ? 2 : 0];
+        float v = withArrayOfCoordinates[(i >= 2) ? 3 : 1];
+        DGVector point = DGMakeFacePoint(onFace, u, v);
+        
+        vertCoords[i * 3] = (GLfloat)point.x;
+        vertCoords[i * 3 + 1] = (GLfloat)point.y;
+        vertCoords[i * 3 + 2] = (GLfloat)point.z;
+    }
+    
+	if (_texturesEnabled) {
+		static GLfloat texCoords[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+		glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+	}
+    
+	glVertexPointer(3, GL_FLOAT, 0, vertCoords);
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+}
+
 void DGRenderManager::setAlpha(float alpha) {
     // NOTE: This resets the current so it should be used with care
     glColor4f(1.0f, 1.0f, 1.0f, alpha);
@@ -471,29 +506,211 @@ void DGRenderManager::setColor(int color, float alpha) {
         glColor4f((float)(r / 255.0f), (float)(g / 255.0f), (float)(b / 255.0f), (float)(a / 255.f));
 }
 
-// FIXME: glReadPixels has an important performace hit on older computers. Improve.
-int	DGRenderManager::testColor(int xPosition, int yPosition) {
-	// This is static because it sometimes throws a stack corruption error
-    static GLubyte pixel[3];
-	GLint r, g, b;
-	uint32_t aux;
+////////////////////////////////////////////////////////////
+// Implementation - Sprites
+////////////////////////////////////////////////////////////
+
+void DGRenderManager::drawHelper(int xPosition, int yPosition, int color, bool animate) {
+    const int numPoints = (DGDefCursorDetail / 2) + 2;
+    GLfloat outer[numPoints][2], inner[numPoints][2], disc[numPoints][2];
+    GLfloat scaleX, scaleY, discX, discY;
+    GLubyte rgba[4];
+    DGSprite sprite;
+    
+    if (animate) {
+        _unpackColor(color, 1.0f - _helperLoop, rgba);
+        scaleX = scaleY = _helperLoop * 2.0f;
+        discX = discY = scaleX * 0.85f * _helperLoop;
+    }
+    else {
+        _unpackColor(color, 1.0f, rgba);
+        scaleX = 1.0f;
+        scaleY = 1.1f;
+        discX = 0.835f;
+        discY = scaleY * 0.85f;
+    }
+    
+    for (int i = 0; i < numPoints; i++) {
+        GLfloat x = _defCursor[i * 2] * scaleX;
+        GLfloat y = _defCursor[(i * 2) + 1] * scaleY;
+        GLfloat length = sqrtf((x * x) + (y * y));
+        GLfloat factor = (length > 1.0f) ? (length - 1.0f) / length : 0.0f;
+        
+        // The outline is one pixel wide, like the line it replaces
+        outer[i][0] = xPosition + x;
+        outer[i][1] = yPosition + y;
+        inner[i][0] = xPosition + (x * factor);
+        inner[i][1] = yPosition + (y * factor);
+        disc[i][0] = xPosition + (_defCursor[i * 2] * discX);
+        disc[i][1] = yPosition + (_defCursor[(i * 2) + 1] * discY);
+    }
+    
+    sprite.texture = NULL;
+    sprite.layer = animate ? DGSpriteLayerHelpers : DGSpriteLayerCursor;
+    sprite.isAdditive = !animate;
+    sprite.firstVertex = _arrayOfSpriteVertices.size();
+    
+    for (int i = 0; i < numPoints; i++) {
+        int j = (i + 1) % numPoints;
+        
+        _addSpriteVertex(outer[i][0], outer[i][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(outer[j][0], outer[j][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(inner[j][0], inner[j][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(outer[i][0], outer[i][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(inner[j][0], inner[j][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(inner[i][0], inner[i][1], 0.0f, 0.0f, rgba);
+    }
+    
+    // The fan of the disc, as triangles
+    for (int i = 1; i < numPoints - 1; i++) {
+        _addSpriteVertex(disc[0][0], disc[0][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(disc[i][0], disc[i][1], 0.0f, 0.0f, rgba);
+        _addSpriteVertex(disc[i + 1][0], disc[i + 1][1], 0.0f, 0.0f, rgba);
+    }
+    
+    sprite.numVertices = _arrayOfSpriteVertices.size() - sprite.firstVertex;
+    _queueSprite(sprite);
+}
+
+void DGRenderManager::drawSprite(DGTexture* texture, float* withArrayOfCoordinates, float* withArrayOfTexCoords,
+                                 int color, float alpha, int layer) {
+    static const float texCoords[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    static const int corners[] = {0, 1, 2, 0, 2, 3}; // The fan of a slide
+    const float* arrayOfTexCoords = withArrayOfTexCoords ? withArrayOfTexCoords : texCoords;
+    GLubyte rgba[4];
+    DGSprite sprite;
+    
+    _unpackColor(color, alpha, rgba);
+    
+    sprite.texture = texture;
+    sprite.layer = layer;
+    sprite.isAdditive = false;
+    sprite.firstVertex = _arrayOfSpriteVertices.size();
+    sprite.numVertices = 6;
+    
+    for (int i = 0; i < 6; i++) {
+        int corner = corners[i] * 2;
+        
+        _addSpriteVertex(withArrayOfCoordinates[corner], withArrayOfCoordinates[corner + 1],
+                         arrayOfTexCoords[corner], arrayOfTexCoords[corner + 1], rgba);
+    }
+    
+    _queueSprite(sprite);
+}
+
+void DGRenderManager::flushSprites() {
+    if (_arrayOfSprites.empty())
+        return;
+    
+    vector<DGSprite>::iterator it;
+    const GLubyte* base;
+    GLsizei stride = sizeof(DGSpriteVertex);
+    GLint first = 0;
+    
+    // Lay out the vertices in the order they are drawn
+    _arrayOfBatchedVertices.clear();
+    
+    it = _arrayOfSprites.begin();
+    
+    while (it != _arrayOfSprites.end()) {
+        _arrayOfBatchedVertices.insert(_arrayOfBatchedVertices.end(),
+                                       _arrayOfSpriteVertices.begin() + (*it).firstVertex,
+                                       _arrayOfSpriteVertices.begin() + (*it).firstVertex + (*it).numVertices);
+        it++;
+    }
     
-    // Note we flip the Y coordinate here because only the orthogonal projection is flipped
-	glReadPixels(xPosition, config->displayHeight - yPosition, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, pixel);
+    if (_spriteBuffer) {
+        GLsizeiptr size = _arrayOfBatchedVertices.size() * stride;
+        
+        // Orphan the previous contents rather than wait until drawn
+        glBindBuffer(GL_ARRAY_BUFFER, _spriteBuffer);
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, &_arrayOfBatchedVertices[0]);
+        base = NULL;
+    }
+    else base = (const GLubyte*)&_arrayOfBatchedVertices[0];
+    
+    glVertexPointer(2, GL_FLOAT, stride, base);
+    glTexCoordPointer(2, GL_FLOAT, stride, base + offsetof(DGSpriteVertex, s));
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride, base + offsetof(DGSpriteVertex, color));
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    
+    it = _arrayOfSprites.begin();
+    
+    while (it != _arrayOfSprites.end()) {
+        DGTexture* texture = (*it).texture;
+        bool isAdditive = (*it).isAdditive;
+        GLsizei count = 0;
+        
+        // Take the following sprites that need no change of state
+        do {
+            count += (*it).numVertices;
+            it++;
+        } while (it != _arrayOfSprites.end() && (*it).texture == texture && (*it).isAdditive == isAdditive);
+        
+        if (texture) {
+            glEnable(GL_TEXTURE_2D);
+            texture->bind();
+        }
+        else glDisable(GL_TEXTURE_2D);
+        
+        if (isAdditive)
+            glBlendFunc(GL_ONE, GL_ONE);
+        else
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        
+        glDrawArrays(GL_TRIANGLES, first, count);
+        first += count;
+    }
+    
+    glDisableClientState(GL_COLOR_ARRAY);
+    
+    if (_texturesEnabled)
+        glEnable(GL_TEXTURE_2D);
+    else {
+        glDisable(GL_TEXTURE_2D);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+    
+    if (_alphaEnabled)
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    else 
+        glBlendFunc(GL_ONE, GL_ZERO);
     
-    r = (GLint)pixel[0];
-	g = (GLint)pixel[1];
-	b = (GLint)pixel[2];
+    if (_spriteBuffer)
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
     
-	aux = ((r & 0xff) << 16) | ((g & 0xff) << 8) | (b & 0xff);
+    // The current color is undefined after drawing from an array of them
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
     
-	return aux;
+    _arrayOfSprites.clear();
+    _arrayOfSpriteVertices.clear();
 }
 
 ////////////////////////////////////////////////////////////
 // Implementation - Helpers processing
 ////////////////////////////////////////////////////////////
 
+void DGRenderManager::addHelper(int index) {
+    DGSpotRange* range = &_spotBuffer->arrayOfRanges[index];
+    DGVector vector;
+    
+    if (!range->numIndices)
+        return;
+    
+    vector = this->project(range->center.x, range->center.y, range->center.z);
+    
+    if (vector.z < 1.0f) { // Only store coordinates on screen
+        DGPoint point;
+        
+        point.x = (int)vector.x;
+        point.y = (int)vector.y;  
+        
+        _arrayOfHelpers.push_back(point);
+    }
+}
+
 bool DGRenderManager::beginIteratingHelpers() {
     if (!_arrayOfHelpers.empty()) {
         if (_helperLoop > 1.0f) _helperLoop = 0.0f;
@@ -612,6 +829,110 @@ void DGRenderManager::fadeView() {
 // Implementation - Private methods
 ////////////////////////////////////////////////////////////
 
+void DGRenderManager::_addSpriteVertex(GLfloat x, GLfloat y, GLfloat s, GLfloat t, GLubyte* color) {
+    DGSpriteVertex vertex;
+    
+    vertex.x = x;
+    vertex.y = y;
+    vertex.s = s;
+    vertex.t = t;
+    memcpy(vertex.color, color, sizeof(vertex.color));
+    
+    _arrayOfSpriteVertices.push_back(vertex);
+}
+
+void DGRenderManager::_buildSpots(DGNode* node, DGSpotBuffer* spotBuffer) {
+    // Half a texel in, as spots have always been drawn
+    const float texU = (float)1 / (DGDefTexSize * 2);
+    const float texV = (float)((DGDefTexSize * 2) - 1) / (DGDefTexSize * 2);
+    
+    spotBuffer->arrayOfVertices.clear();
+    spotBuffer->arrayOfIndices.clear();
+    spotBuffer->arrayOfRanges.clear();
+    
+    if (node->hasSpots()) {
+        node->beginIteratingSpots();
+        do {
+            DGSpot* spot = node->currentSpot();
+            vector<int> arrayOfCoordinates = spot->arrayOfCoordinates();
+            int numVertices = (int)arrayOfCoordinates.size() / 2;
+            int first = (int)spotBuffer->arrayOfVertices.size() / 5;
+            int face = spot->face() % 6;
+            int minX = 0, maxX = 0, minY = 0, maxY = 0;
+            DGSpotRange range;
+            
+            for (int i = 0; i < numVertices; i++) {
+                int x = arrayOfCoordinates[i * 2];
+                int y = arrayOfCoordinates[(i * 2) + 1];
+                
+                minX = i ? min(minX, x) : x;
+                maxX = i ? max(maxX, x) : x;
+                minY = i ? min(minY, y) : y;
+                maxY = i ? max(maxY, y) : y;
+            }
+            
+            for (int i = 0; i < numVertices; i++) {
+                int x = arrayOfCoordinates[i * 2];
+                int y = arrayOfCoordinates[(i * 2) + 1];
+                DGVector point = DGMakeFacePoint(face, (double)x / DGDefTexSize, (double)y / DGDefTexSize);
+                float u, v;
+                
+                // Quads take the corners in order, as those resized to fit
+                // their texture. Other polygons cover it by their bounds.
+                if (numVertices == 4) {
+                    u = ((i == 1) || (i == 2)) ? texV : texU;
+                    v = (i >= 2) ? texV : texU;
+                }
+                else {
+                    u = texU + ((texV - texU) * (x - minX) / (float)max(maxX - minX, 1));
+                    v = texU + ((texV - texU) * (y - minY) / (float)max(maxY - minY, 1));
+                }
+                
+                spotBuffer->arrayOfVertices.push_back((GLfloat)point.x);
+                spotBuffer->arrayOfVertices.push_back((GLfloat)point.y);
+                spotBuffer->arrayOfVertices.push_back((GLfloat)point.z);
+                spotBuffer->arrayOfVertices.push_back(u);
+                spotBuffer->arrayOfVertices.push_back(v);
+            }
+            
+            // The same fan the polygon was drawn with
+            range.firstIndex = (GLsizei)spotBuffer->arrayOfIndices.size();
+            
+            for (int i = 1; i < (numVertices - 1); i++) {
+                spotBuffer->arrayOfIndices.push_back((GLushort)first);
+                spotBuffer->arrayOfIndices.push_back((GLushort)(first + i));
+                spotBuffer->arrayOfIndices.push_back((GLushort)(first + i + 1));
+            }
+            
+            range.numIndices = (GLsizei)spotBuffer->arrayOfIndices.size() - range.firstIndex;
+            range.revision = spot->revision();
+            
+            if (range.numIndices) {
+                DGPoint center = _centerOfPolygon(arrayOfCoordinates);
+                
+                range.center = DGMakeFacePoint(face, center.x / DGDefTexSize, center.y / DGDefTexSize);
+            }
+            else {
+                range.center.x = 0.0;
+                range.center.y = 0.0;
+                range.center.z = 0.0;
+            }
+            
+            spotBuffer->arrayOfRanges.push_back(range);
+        } while (node->iterateSpots());
+    }
+    
+    if (spotBuffer->vertexBuffer) {
+        glBindBuffer(GL_ARRAY_BUFFER, spotBuffer->vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, spotBuffer->arrayOfVertices.size() * sizeof(GLfloat),
+                     spotBuffer->arrayOfVertices.empty() ? NULL : &spotBuffer->arrayOfVertices[0], GL_STATIC_DRAW);
+        
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spotBuffer->indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, spotBuffer->arrayOfIndices.size() * sizeof(GLushort),
+                     spotBuffer->arrayOfIndices.empty() ? NULL : &spotBuffer->arrayOfIndices[0], GL_STATIC_DRAW);
+    }
+}
+
 DGPoint DGRenderManager::_centerOfPolygon(vector<int> arrayOfCoordinates) {
     DGPoint center;    
     int vertex = arrayOfCoordinates.size() / 2;
@@ -715,3 +1036,26 @@ void DGRenderManager::_initFrameBufferTexture() {
     // Unbind the texture  
     glBindTexture(GL_TEXTURE_2D, 0);  
 }
+
+void DGRenderManager::_queueSprite(DGSprite sprite) {
+    vector<DGSprite>::iterator it;
+    
+    // After those of the same layer, so that these keep their order
+    it = _arrayOfSprites.end();
+    while (it != _arrayOfSprites.begin() && (*(it - 1)).layer > sprite.layer)
+        it--;
+    
+    _arrayOfSprites.insert(it, sprite);
+}
+
+void DGRenderManager::_unpackColor(int color, float alpha, GLubyte* rgba) {
+   	uint32_t aux = color;
+    
+    if (alpha < 0.0f) alpha = 0.0f;
+    else if (alpha > 1.0f) alpha = 1.0f;
+    
+	rgba[0] = (aux & 0x00ff0000) >> 16;
+	rgba[1] = (aux & 0x0000ff00) >> 8;
+	rgba[2] = (aux & 0x000000ff);
+	rgba[3] = (GLubyte)(((aux & 0xff000000) >> 24) * alpha);
+}
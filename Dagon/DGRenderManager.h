@@ -26,11 +26,53 @@
 
 #define DGDefCursorDetail 30
 
+// Spots only change when resized to fit their texture, so the polygons of
+// each node are converted once into triangles kept in buffers, along with
+// their texture coordinates. Every spot draws a range of the indices.
+typedef struct {
+    GLsizei firstIndex;
+    GLsizei numIndices;
+    DGVector center; // Projected for the helpers
+    int revision; // Of the spot when converted
+} DGSpotRange;
+
+typedef struct DGSpotBuffer {
+    GLuint vertexBuffer; // Zero if not supported, drawn from the arrays then
+    GLuint indexBuffer;
+    std::vector<GLfloat> arrayOfVertices; // Position and texture coordinates
+    std::vector<GLushort> arrayOfIndices;
+    std::vector<DGSpotRange> arrayOfRanges; // One per spot, in the same order
+} DGSpotBuffer;
+
 class DGConfig;
 class DGEffectsManager;
 class DGLog;
+class DGNode;
 class DGTexture;
 
+// Overlays, helpers and the cursor are queued as sprites and drawn together
+// from a single stream, lower layers first. Sprites keep their order within
+// a layer, and those in a row sharing a texture go in the same call.
+enum DGSpriteLayers {
+    DGSpriteLayerHelpers,
+    DGSpriteLayerOverlays,
+    DGSpriteLayerCursor
+};
+
+typedef struct {
+    GLfloat x, y;
+    GLfloat s, t;
+    GLubyte color[4]; // Fades are in the alpha of each vertex
+} DGSpriteVertex;
+
+typedef struct {
+    DGTexture* texture; // Only coloured if NULL
+    int layer;
+    bool isAdditive;
+    GLsizei firstVertex;
+    GLsizei numVertices;
+} DGSprite;
+
 // Reference to embedded splash screen
 extern "C" const unsigned char DGDefSplashBinary[];
 
@@ -61,10 +103,22 @@ class DGRenderManager {
     DGTexture* _blendTexture;
     DGTexture* _fadeTexture;   
     
+    std::vector<DGSpotBuffer*> _arrayOfSpotBuffers;
+    DGSpotBuffer* _spotBuffer; // Set by beginSpots()
+    
+    std::vector<DGSprite> _arrayOfSprites; // Sorted by layer
+    std::vector<DGSpriteVertex> _arrayOfSpriteVertices; // As queued
+    std::vector<DGSpriteVertex> _arrayOfBatchedVertices; // As drawn
+    GLuint _spriteBuffer; // Streamed on every flush, zero if not supported
+    
+    void _addSpriteVertex(GLfloat x, GLfloat y, GLfloat s, GLfloat t, GLubyte* color);
+    void _buildSpots(DGNode* node, DGSpotBuffer* spotBuffer);
     DGPoint _centerOfPolygon(std::vector<int> arrayOfCoordinates); // Used for the helpers feature
     void _initFrameBuffer();
     void _initFrameBufferDepthBuffer();
     void _initFrameBufferTexture();
+    void _queueSprite(DGSprite sprite);
+    void _unpackColor(int color, float alpha, GLubyte* rgba); // Alpha is a factor
     
     std::vector<DGPoint> _arrayOfHelpers;
     std::vector<DGPoint>::iterator _itHelper;
@@ -98,6 +152,10 @@ public:
     
     DGVector project(float x, float y, float z); // If more than three coordinates, attempts to calculate center
     DGVector unProject(int x, int y);
+    
+    // The ray through the given point of the screen, from the near plane
+    // towards the far one, in the space of the current view
+    void unProjectRay(int x, int y, DGVector* origin, DGVector* direction);
 
     // Drawing operations
     
@@ -107,16 +165,31 @@ public:
     void disableAlpha();
     void disablePostprocess();
     void disableTextures();
-    void drawHelper(int xPosition, int yPosition, bool animate);
-    void drawPolygon(std::vector<int> withArrayOfCoordinates, unsigned int onFace);
+    
+    // Spots are drawn from the buffers of their node, converted again
+    // whenever a spot is added or resized, so these bracket drawSpot()
+    void beginSpots(DGNode* node);
+    void endSpots();
+    
+    void drawCubeMap(); // Expects the cube map of the node to be bound
     void drawPostprocessedView(); // Expects orthogonal mode
-    void drawSlide(float* withArrayOfCoordinates); // We use float in all "slides" since we need the precision
+    void drawSlide(float* withArrayOfCoordinates, float* withArrayOfTexCoords = NULL); // We use float in all "slides" since we need the precision
+    void drawSpot(int index); // Of the spot in the node
+    void drawTile(unsigned int onFace, float* withArrayOfCoordinates); // Part of the face, from 0 to 1
     void setAlpha(float alpha);
     void setColor(int color, float alpha = 0);
-    int	testColor(int xPosition, int yPosition);
+    
+    // Sprites are only queued, then drawn by flushSprites() in as few calls
+    // as possible. Textures may be NULL for coloured sprites.
+    
+    void drawHelper(int xPosition, int yPosition, int color, bool animate);
+    void drawSprite(DGTexture* texture, float* withArrayOfCoordinates, float* withArrayOfTexCoords,
+                    int color, float alpha, int layer = DGSpriteLayerOverlays);
+    void flushSprites();
     
     // Helpers processing (indicates clickable spots)
     
+    void addHelper(int index); // At the center of the spot, if on screen
     bool beginIteratingHelpers();
     DGPoint currentHelper();
     bool iterateHelpers();
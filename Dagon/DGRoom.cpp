@@ -62,6 +62,10 @@ vector<DGAudio*> DGRoom::arrayOfAudios() {
     return _arrayOfAudios;
 }
 
+vector<DGNode*> DGRoom::arrayOfNodes() {
+    return _arrayOfNodes;
+}
+
 DGNode* DGRoom::currentNode() {
     return _currentNode;
 }
@@ -55,6 +55,7 @@ public:
     // Gets
     
     std::vector<DGAudio*> arrayOfAudios();
+    std::vector<DGNode*> arrayOfNodes();
     DGNode* currentNode();
     DGAudio* defaultFootstep();
     int effectsFlags();
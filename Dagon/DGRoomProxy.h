@@ -85,6 +85,22 @@ public:
         return 0;
     }
     
+    // Loads the room in the background, passing the progress to the given
+    // function every frame, from 0 to 1
+    int preload(lua_State *L) {
+        if (!lua_isfunction(L, -1)) {
+            DGLog::getInstance().error(DGModScript, "%s", DGMsg250013);
+            
+            return 0;
+        }
+        
+        int ref = luaL_ref(L, LUA_REGISTRYINDEX);  // Pop and return a reference to the table.
+        
+        DGControl::getInstance().preload(r, ref);
+        
+        return 0;
+    }
+    
     // Set the default footstep
     int setDefaultFootstep(lua_State *L) {
         if (DGCheckProxy(L, 1) == DGObjectAudio) {
@@ -137,6 +153,7 @@ Luna<DGRoomProxy>::RegType DGRoomProxy::methods[] = {
     DGObjectMethods(DGRoomProxy),    
     method(DGRoomProxy, addAudio),
     method(DGRoomProxy, addNode),
+    method(DGRoomProxy, preload),
     method(DGRoomProxy, setDefaultFootstep),    
     method(DGRoomProxy, startTimer),     
     {0,0}
@@ -25,6 +25,7 @@
 #include "DGSpot.h"
 #include "DGSystem.h" // Temporary, we don't want this class calling system
 #include "DGTexture.h"
+#include "DGTextureManager.h"
 #include "DGVideoManager.h"
 
 using namespace std;
@@ -41,6 +42,7 @@ DGScene::DGScene() {
     config = &DGConfig::getInstance();  
     cursorManager = &DGCursorManager::getInstance();
     renderManager = &DGRenderManager::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     videoManager = &DGVideoManager::getInstance();
     
     _canDrawSpots = false;
@@ -84,47 +86,117 @@ void DGScene::drawSpots() {
             currentNode->updateFade();
             renderManager->setAlpha(currentNode->fadeLevel());
             
-            currentNode->beginIteratingSpots();
-            do {
-                DGSpot* spot = currentNode->currentSpot();
+            // The whole cube is drawn at once, spots go on top. Its preview
+            // stands in until it's loaded.
+            if (currentNode->hasCubeMap() &&
+                (currentNode->cubeMap()->isLoaded() || currentNode->cubeMap()->hasPreview())) {
+                currentNode->cubeMap()->bind();
+                renderManager->drawCubeMap();
+            }
+            
+            // Tiles are drawn as they arrive, the smallest first, so that
+            // the view sharpens progressively
+            if (currentNode->hasTileSet()) {
+                vector<DGTile*>::iterator it;
+                
+                textureManager->requestTiles(currentNode->tileSet(), _arrayOfVisibleTiles);
                 
-                if (spot->hasTexture() && spot->isEnabled()) {
+                it = _arrayOfVisibleTiles.begin();
+                
+                while (it != _arrayOfVisibleTiles.end()) {
+                    if ((*it)->texture->isLoaded()) {
+                        (*it)->texture->bind();
+                        renderManager->drawTile((*it)->face, (*it)->coords);
+                    }
                     
-                    if (spot->hasVideo()) {
-                        // If it has a video, we need to check if it's playing
-                        if (spot->isPlaying()) { // FIXME: Must stop the spot later!
+                    it++;
+                }
+            }
+            
+            if (currentNode->hasSpots()) {
+                DGTexture* boundTexture = NULL;
+                int index = 0;
+                
+                _arrayOfDrawnSpots.clear();
+                
+                currentNode->beginIteratingSpots();
+                do {
+                    DGSpot* spot = currentNode->currentSpot();
+                    DGDrawnSpot drawnSpot;
+                    
+                    drawnSpot.spot = spot;
+                    drawnSpot.index = index++;
+                    
+                    if (spot->hasTexture() && spot->isEnabled()) {
+                        // Textures still being loaded are skipped until they are
+                        // uploaded, unless they have a preview
+                        if (!spot->hasVideo() && !spot->texture()->isLoaded() &&
+                            !spot->texture()->hasPreview())
+                            continue;
+                        
+                        // Only resize if nothing but origin
+                        if ((spot->vertexCount() == 1) && spot->texture()->isLoaded())
+                            spot->resize(spot->texture()->width(), spot->texture()->height());
+                        
+                        if (spot->hasVideo()) {
+                            // If it has a video, we need to check if it's playing
+                            if (!spot->isPlaying()) // FIXME: Must stop the spot later!
+                                continue;
+                            
                             if (spot->video()->hasNewFrame()) {
                                 DGFrame* frame = spot->video()->currentFrame();
                                 DGTexture* texture = spot->texture();
                                 texture->loadRawData(frame->data, frame->width, frame->height);
                             }
-                            
-                            spot->texture()->bind();
-                            renderManager->drawPolygon(spot->arrayOfCoordinates(), spot->face());
                         }
+                        
+                        // Keep the order in which they were added among
+                        // spots with the same z-order
+                        vector<DGDrawnSpot>::iterator it = _arrayOfDrawnSpots.end();
+                        
+                        while ((it != _arrayOfDrawnSpots.begin()) &&
+                               ((it - 1)->spot->zOrder() > spot->zOrder()))
+                            it--;
+                        
+                        _arrayOfDrawnSpots.insert(it, drawnSpot);
                     }
-                    else {
-                        // Draw right away...
-                        spot->texture()->bind();
-                        renderManager->drawPolygon(spot->arrayOfCoordinates(), spot->face());
+                } while (currentNode->iterateSpots());
+                
+                // After resizing, so that the geometry is up to date
+                renderManager->beginSpots(currentNode);
+                
+                for (unsigned int i = 0; i < _arrayOfDrawnSpots.size(); i++) {
+                    DGTexture* texture = _arrayOfDrawnSpots[i].spot->texture();
+                    
+                    // Spots in a row sharing the texture bind it once
+                    if (texture != boundTexture) {
+                        texture->bind();
+                        boundTexture = texture;
                     }
+                    
+                    renderManager->drawSpot(_arrayOfDrawnSpots[i].index);
                 }
-            } while (currentNode->iterateSpots());
-            
-            if (config->showSpots) {
-                renderManager->disableTextures();
                 
-                currentNode->beginIteratingSpots();
-                do {
-                    DGSpot* spot = currentNode->currentSpot();
+                if (config->showSpots) {
+                    renderManager->disableTextures();
+                    index = 0;
                     
-                    if (spot->hasColor() && spot->isEnabled()) {
-                        renderManager->setColor(0x2500AAAA);
-                        renderManager->drawPolygon(spot->arrayOfCoordinates(), spot->face());
-                    }
-                } while (currentNode->iterateSpots());
+                    currentNode->beginIteratingSpots();
+                    do {
+                        DGSpot* spot = currentNode->currentSpot();
+                        
+                        if (spot->hasColor() && spot->isEnabled()) {
+                            renderManager->setColor(0x2500AAAA);
+                            renderManager->drawSpot(index);
+                        }
+                        
+                        index++;
+                    } while (currentNode->iterateSpots());
+                    
+                    renderManager->enableTextures();
+                }
                 
-                renderManager->enableTextures();
+                renderManager->endSpots();
             }
             
             renderManager->disablePostprocess();
@@ -158,56 +230,48 @@ bool DGScene::scanSpots() {
         
         // Check if the current node is enabled
         if (currentNode->isEnabled()) {
-            renderManager->disableAlpha();
-            renderManager->disableTextures();
-            
-            // First pass: draw the colored spots
-            currentNode->beginIteratingSpots();
-            do {
-                DGSpot* spot = currentNode->currentSpot();
+            if (currentNode->hasSpots()) {
+                int index = 0;
                 
-                if (spot->hasColor() && spot->isEnabled()) {
-                    renderManager->setColor(spot->color());
-                    renderManager->drawPolygon(spot->arrayOfCoordinates(), spot->face());
-                }
-            } while (currentNode->iterateSpots());
-            
-            // Second pass: test the color under the cursor and
-            // set action, if available
-            
-            // FIXME: Should unify the checks here a bit more...
-            if (!cursorManager->isDragging() && !cursorManager->onButton()) {
-                DGPoint position = cursorManager->position();
-                int color = renderManager->testColor(position.x, position.y);
-                if (color) {
-                    currentNode->beginIteratingSpots();
-                    do {
-                        DGSpot* spot = currentNode->currentSpot();
-                        if (color == spot->color()) {
-                            cursorManager->setAction(spot->action());
-                            foundAction = true;
-                            
-                            break;
-                        }
-                    } while (currentNode->iterateSpots());
-                }
+                // First pass: show helpers on the colored spots
+                renderManager->beginSpots(currentNode);
                 
-                if (!foundAction) {
-                    cursorManager->removeAction();
+                currentNode->beginIteratingSpots();
+                do {
+                    DGSpot* spot = currentNode->currentSpot();
+                    
+                    if (spot->hasColor() && spot->isEnabled())
+                        renderManager->addHelper(index);
                     
-                    if (cameraManager->isPanning())
-                        cursorManager->setCursor(cameraManager->cursorWhenPanning());
-                    else cursorManager->setCursor(DGCursorNormal);
+                    index++;
+                } while (currentNode->iterateSpots());
+                
+                renderManager->endSpots();
+                
+                // Second pass: find the spot under the cursor and
+                // set action, if available
+                
+                // FIXME: Should unify the checks here a bit more...
+                if (!cursorManager->isDragging() && !cursorManager->onButton()) {
+                    DGSpot* spot = _spotAt(currentNode, cursorManager->position());
+                    
+                    if (spot) {
+                        cursorManager->setAction(spot->action());
+                        foundAction = true;
+                    }
+                    
+                    if (!foundAction) {
+                        cursorManager->removeAction();
+                        
+                        if (cameraManager->isPanning())
+                            cursorManager->setCursor(cameraManager->cursorWhenPanning());
+                        else cursorManager->setCursor(DGCursorNormal);
+                    }
                 }
             }
-            
-            renderManager->enableAlpha();
-            renderManager->enableTextures();
         }
     }
     
-    renderManager->clearView();
-    
     if (foundAction) return true;
     else return false;
 }
@@ -219,7 +283,7 @@ void DGScene::setRoom(DGRoom* room) {
     DGNode* node = _currentRoom->currentNode();
     
     if (node) {
-        if (node->hasSpots())
+        if (node->hasSpots() || node->hasCubeMap() || node->hasTileSet())
             _canDrawSpots = true;
         else
             _canDrawSpots = false;
@@ -317,3 +381,41 @@ void DGScene::unloadSplash() {
     delete _splashTexture;
     _isSplashLoaded = false;
 }
+
+////////////////////////////////////////////////////////////
+// Implementation - Private methods
+////////////////////////////////////////////////////////////
+
+// Casts a ray through the given point of the screen against the plane of
+// each face, and returns the last colored spot it hits, as that one is
+// drawn on top. Disabled spots are skipped.
+DGSpot* DGScene::_spotAt(DGNode* node, DGPoint position) {
+    DGVector origin, direction;
+    DGPoint arrayOfPoints[6];
+    bool isFaceHit[6];
+    DGSpot* spotHit = NULL;
+    
+    renderManager->unProjectRay((int)position.x, (int)position.y, &origin, &direction);
+    
+    for (int i = 0; i < 6; i++) {
+        double u = 0.0, v = 0.0;
+        
+        isFaceHit[i] = DGIntersectFace(i, origin, direction, &u, &v);
+        
+        // Spots are given in the default size of the faces
+        arrayOfPoints[i].x = u * DGDefTexSize;
+        arrayOfPoints[i].y = v * DGDefTexSize;
+    }
+    
+    node->beginIteratingSpots();
+    do {
+        DGSpot* spot = node->currentSpot();
+        int face = spot->face() % 6;
+        
+        if (spot->hasColor() && spot->isEnabled() && isFaceHit[face] &&
+            spot->contains(arrayOfPoints[face]))
+            spotHit = spot;
+    } while (node->iterateSpots());
+    
+    return spotHit;
+}
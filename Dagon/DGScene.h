@@ -17,6 +17,7 @@
 // Headers
 ////////////////////////////////////////////////////////////
 
+#include "DGTextureManager.h"
 #include "DGVideo.h"
 
 ////////////////////////////////////////////////////////////
@@ -26,11 +27,18 @@
 class DGCameraManager;
 class DGConfig;
 class DGCursorManager;
+class DGNode;
 class DGRenderManager;
 class DGRoom;
-class DGTexture;
+class DGSpot;
 class DGVideoManager;
 
+// Spots drawn in a frame, sorted by their z-order
+typedef struct {
+    DGSpot* spot;
+    int index; // In the node, to find its geometry
+} DGDrawnSpot;
+
 ////////////////////////////////////////////////////////////
 // Interface
 ////////////////////////////////////////////////////////////
@@ -42,6 +50,7 @@ class DGScene {
     DGConfig* config;
     DGCursorManager* cursorManager;   
     DGRenderManager* renderManager;
+    DGTextureManager* textureManager;
     DGVideoManager* videoManager;
     
     // Other classes
@@ -49,10 +58,16 @@ class DGScene {
     DGTexture* _cutsceneTexture;
     DGTexture* _splashTexture;
     
+    // Reused every frame
+    std::vector<DGDrawnSpot> _arrayOfDrawnSpots;
+    std::vector<DGTile*> _arrayOfVisibleTiles;
+    
     bool _canDrawSpots; // This bool is used to make checks faster
     bool _isCutsceneLoaded;
     bool _isSplashLoaded;
     
+    DGSpot* _spotAt(DGNode* node, DGPoint position);
+    
 public:
     DGScene();
     ~DGScene();
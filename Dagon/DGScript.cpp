@@ -226,12 +226,35 @@ void DGScript::processCallback(int handler, int object) {
     }
 }
 
+void DGScript::processCallback(int handler, int object, double argument) {
+    if (object) {
+        lua_rawgeti(_thread, LUA_REGISTRYINDEX, object);
+        lua_setglobal(_thread, "self");
+    }
+    
+    lua_rawgeti(_thread, LUA_REGISTRYINDEX, handler);
+    lua_pushnumber(_thread, argument);
+    
+    if (_isSuspended) {
+        if (int result =  lua_pcall(_thread, 1, 0, 0))
+            _error(result);
+    }
+    else {
+        if (int result = lua_resume(_thread, 1))
+            _error(result);
+    }
+}
+
 void DGScript::processCommand(const char *command) {
     if (int result = luaL_loadbuffer(_thread, command, strlen(command), "command") ||
                     lua_pcall(_thread, 0, 0, 0))
         _error(result);
 }
 
+void DGScript::releaseHandler(int handler) {
+    luaL_unref(_L, LUA_REGISTRYINDEX, handler);
+}
+
 void DGScript::resume() {
     if (_isSuspended) {
         _isSuspended = false;
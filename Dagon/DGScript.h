@@ -107,7 +107,11 @@ public:
     const char* module();
     bool isExecutingModule();    
     void processCallback(int handler, int object);    
+    
+    // Passes the given number to the handler, such as a progress
+    void processCallback(int handler, int object, double argument);
     void processCommand(const char* command);
+    void releaseHandler(int handler); // Once no longer called
     void resume();
     void run();
     void setModule(const char* module);
@@ -40,6 +40,7 @@ DGSpot::DGSpot(std::vector<int> withArrayOfCoordinates, unsigned int onFace, int
 	_arrayOfCoordinates = withArrayOfCoordinates;
 	_onFace = onFace;
 	
+	_revision = 0;
 	_xOrigin = 0;
 	_yOrigin = 0;
 	_zOrder = 0;
@@ -62,6 +63,37 @@ DGSpot::~DGSpot() {
 // Implementation - Checks
 ////////////////////////////////////////////////////////////
 
+bool DGSpot::contains(DGPoint point) {
+    int numVertices = (int)_arrayOfCoordinates.size() / 2;
+    
+    // The same fan the Render Manager draws, so that concave spots
+    // respond exactly where they would be seen
+    for (int i = 1; i < (numVertices - 1); i++) {
+        double x[3] = {(double)_arrayOfCoordinates[0], (double)_arrayOfCoordinates[i * 2],
+                       (double)_arrayOfCoordinates[(i + 1) * 2]};
+        double y[3] = {(double)_arrayOfCoordinates[1], (double)_arrayOfCoordinates[(i * 2) + 1],
+                       (double)_arrayOfCoordinates[((i + 1) * 2) + 1]};
+        bool hasNegative = false;
+        bool hasPositive = false;
+        
+        // On the same side of every edge, whatever the winding
+        for (int j = 0; j < 3; j++) {
+            int k = (j + 1) % 3;
+            double side = ((x[k] - x[j]) * (point.y - y[j])) - ((y[k] - y[j]) * (point.x - x[j]));
+            
+            if (side < 0.0)
+                hasNegative = true;
+            else if (side > 0.0)
+                hasPositive = true;
+        }
+        
+        if (!(hasNegative && hasPositive))
+            return true;
+    }
+    
+    return false;
+}
+
 bool DGSpot::hasAction() {
     return _hasAction;
 }
@@ -113,6 +145,22 @@ vector<int> DGSpot::arrayOfCoordinates() {
     return _arrayOfCoordinates;
 }
 
+DGVector DGSpot::direction() {
+    int minX = _arrayOfCoordinates[0], maxX = _arrayOfCoordinates[0];
+    int minY = _arrayOfCoordinates[1], maxY = _arrayOfCoordinates[1];
+    
+    for (unsigned int i = 2; i < _arrayOfCoordinates.size(); i += 2) {
+        minX = min(minX, _arrayOfCoordinates[i]);
+        maxX = max(maxX, _arrayOfCoordinates[i]);
+        minY = min(minY, _arrayOfCoordinates[i + 1]);
+        maxY = max(maxY, _arrayOfCoordinates[i + 1]);
+    }
+    
+    // Coordinates are given in the default size of the faces
+    return DGMakeFacePoint(_onFace % 6, (double)(minX + maxX) / (2 * DGDefTexSize),
+                           (double)(minY + maxY) / (2 * DGDefTexSize));
+}
+
 unsigned int DGSpot::face() {
     return _onFace;
 }
@@ -126,6 +174,10 @@ DGPoint DGSpot::origin() {
     return _origin;
 }
 
+int DGSpot::revision() {
+    return _revision;
+}
+
 DGTexture* DGSpot::texture() {
     return _attachedTexture;
 }
@@ -142,6 +194,10 @@ float DGSpot::volume() {
     return _volume;
 }
 
+int DGSpot::zOrder() {
+    return _zOrder;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - Sets
 ////////////////////////////////////////////////////////////
@@ -165,6 +221,8 @@ void DGSpot::resize(int width, int height) {
         
     _arrayOfCoordinates[6] = origin.x;
     _arrayOfCoordinates[7] = origin.y + height;
+    
+    _revision++;
 }
 
 void DGSpot::setAction(DGAction* anAction) {
@@ -202,6 +260,7 @@ void DGSpot::setOrigin(int x, int y) {
     
     _xOrigin = x;
     _yOrigin = y;
+    _revision++;
 }
 
 void DGSpot::setTexture(DGTexture* aTexture) {
@@ -218,6 +277,10 @@ void DGSpot::setVideo(DGVideo* aVideo) {
     _hasVideo = true;
 }
 
+void DGSpot::setZOrder(int zOrder) {
+    _zOrder = zOrder;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - State changes
 ////////////////////////////////////////////////////////////
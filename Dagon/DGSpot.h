@@ -62,9 +62,10 @@ class DGSpot : public DGObject {
     std::vector<int> _arrayOfCoordinates;
 	unsigned int _onFace;
 	
+	int _revision; // Increased whenever the coordinates change
 	int _xOrigin;
 	int _yOrigin;
-	int _zOrder; // For future use
+	int _zOrder; // Spots with a higher one are drawn on top
     
 public:
     DGSpot(std::vector<int> withArrayOfCoordinates, unsigned int onFace, int withFlags);
@@ -72,6 +73,9 @@ public:
     
     // Checks
     
+    // Whether the given point, in the coordinates of the face, falls in
+    // any of the triangles the spot is drawn with
+    bool contains(DGPoint point);
     bool hasAction();
     bool hasAudio();
     bool hasColor();
@@ -86,12 +90,15 @@ public:
     DGAudio* audio();
     int color();
     std::vector<int> arrayOfCoordinates();
+    DGVector direction(); // From the center of the cube to the middle of the spot
     unsigned int face();
     DGPoint origin();
+    int revision();
     DGTexture* texture();
     int vertexCount();
     DGVideo* video();
     float volume();
+    int zOrder();
     
     // Sets
     
@@ -102,6 +109,7 @@ public:
     void setTexture(DGTexture* aTexture);
     void setVideo(DGVideo* aVideo);
     void setVolume(float theVolume);
+    void setZOrder(int zOrder);
     
     // State changes
     
@@ -263,6 +263,12 @@ public:
         return 0;
     }
     
+    // Spots with a higher z-order are drawn on top of the rest
+    int setZOrder(lua_State *L) {
+        s->setZOrder((int)luaL_checknumber(L, 1));
+        return 0;
+    }
+    
     // Check if playing
     int isPlaying(lua_State *L) {
         lua_pushboolean(L, s->isPlaying());
@@ -312,6 +318,7 @@ Luna<DGSpotProxy>::RegType DGSpotProxy::methods[] = {
     DGObjectMethods(DGSpotProxy),    
     method(DGSpotProxy, attach),
     method(DGSpotProxy, setCursor),    
+    method(DGSpotProxy, setZOrder),
     method(DGSpotProxy, isPlaying),    
     method(DGSpotProxy, play),
     method(DGSpotProxy, stop),   
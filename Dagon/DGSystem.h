@@ -26,18 +26,23 @@
 // Definitions
 ////////////////////////////////////////////////////////////
 
-#define DGNumberOfThreads 3
+#define DGNumberOfThreads 4
+
+// Texture decoding is spread among a small pool of loaders
+#define DGNumberOfLoaders 2
 
 enum DGThreads {
     DGAudioThread,
     DGTimerThread,
-    DGVideoThread
+    DGVideoThread,
+    DGTextureThread
 };
 
 class DGAudioManager;
 class DGConfig;
 class DGControl;
 class DGLog;
+class DGTextureManager;
 class DGTimerManager;
 class DGVideoManager;
 
@@ -50,6 +55,7 @@ class DGSystem {
     DGControl* control;
     DGConfig* config;
     DGLog* log;
+    DGTextureManager* textureManager;
     DGTimerManager* timerManager;
     DGVideoManager* videoManager;
     
@@ -78,13 +84,16 @@ public:
     void destroyThreads();
     void findPaths(int argc, char* argv[]);
     void init();
+    double monotonicTime(); // In seconds, unlike wallTime() never affected by other threads
     void resumeThread(int threadID);
     void run();
     void setTitle(const char* title);
+    void signalThread(int threadID); // Wakes whoever waits for it
     void suspendThread(int threadID);
     void terminate();
     void toggleFullScreen();
 	void update();
+    void waitForThread(int threadID); // Expects it suspended, and releases it while waiting
     time_t wallTime();
 };
 
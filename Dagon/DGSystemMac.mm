@@ -14,11 +14,14 @@
 // Headers
 ////////////////////////////////////////////////////////////
 
+#import <mach/mach_time.h>
+
 #import "DGAudioManager.h"
 #import "DGConfig.h"
 #import "DGControl.h"
 #import "DGLog.h"
 #import "DGSystem.h"
+#import "DGTextureManager.h"
 #import "DGTimerManager.h"
 #import "DGViewDelegate.h"
 #import "DGVideoManager.h"
@@ -38,6 +41,7 @@ DGViewDelegate* view;
 DGWindowDelegate* windowDelegate;
 
 dispatch_semaphore_t _semaphores[DGNumberOfThreads];
+dispatch_semaphore_t _textureSignal; // Counts, so waiters may wake up early
 
 dispatch_source_t _mainLoop;
 dispatch_source_t _audioThread;
@@ -67,6 +71,7 @@ DGSystem::DGSystem() {
     audioManager = &DGAudioManager::getInstance();
     log = &DGLog::getInstance();
     config = &DGConfig::getInstance();
+    textureManager = &DGTextureManager::getInstance();
     timerManager = &DGTimerManager::getInstance();  
     videoManager = &DGVideoManager::getInstance();
     
@@ -102,11 +107,14 @@ void DGSystem::createThreads() {
     _semaphores[DGAudioThread] = dispatch_semaphore_create(0);
     _semaphores[DGTimerThread] = dispatch_semaphore_create(0);
     _semaphores[DGVideoThread] = dispatch_semaphore_create(0);
+    _semaphores[DGTextureThread] = dispatch_semaphore_create(0);
+    _textureSignal = dispatch_semaphore_create(0);
     
     // Send the first signal
     dispatch_semaphore_signal(_semaphores[DGAudioThread]);
     dispatch_semaphore_signal(_semaphores[DGTimerThread]); 
     dispatch_semaphore_signal(_semaphores[DGVideoThread]);
+    dispatch_semaphore_signal(_semaphores[DGTextureThread]);
     
     _audioThread = CreateDispatchTimer(0.01f * NSEC_PER_SEC, 0,
                                        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0),
@@ -126,6 +134,14 @@ void DGSystem::createThreads() {
                                            videoManager->update();
                                            dispatch_semaphore_signal(_semaphores[DGVideoThread]); });
     
+    // The loaders don't wait on their semaphore, the texture manager
+    // uses it only as a lock for its queues. They run until terminated,
+    // sleeping in the texture manager when there's nothing to do.
+    for (int i = 0; i < DGNumberOfLoaders; i++) {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+                       ^{ while (textureManager->update()); });
+    }
+    
     if (config->debugMode) {
         _profilerThread = CreateDispatchTimer(1.0f * NSEC_PER_SEC, 0,
                                               dispatch_get_main_queue(),
@@ -141,6 +157,8 @@ void DGSystem::destroyThreads() {
     this->suspendThread(DGTimerThread);
     this->suspendThread(DGVideoThread);
     
+    textureManager->terminate();
+    
     dispatch_source_cancel(_audioThread);
     dispatch_source_cancel(_timerThread);
     dispatch_source_cancel(_videoThread);
@@ -149,6 +167,9 @@ void DGSystem::destroyThreads() {
     dispatch_release(_semaphores[DGTimerThread]);
     dispatch_release(_semaphores[DGVideoThread]);
     
+    // Note the texture semaphore isn't released since a loader
+    // may still be finishing its last decode
+    
     // If in debug mode, release the profiler
     if (config->debugMode) {
         dispatch_source_cancel(_profilerThread);
@@ -278,6 +299,15 @@ void DGSystem::init() {
     else log->warning(DGModSystem, "%s", DGMsg140002);
 }
 
+double DGSystem::monotonicTime() {
+    static mach_timebase_info_data_t timebase = {0, 0};
+    
+    if (!timebase.denom)
+        mach_timebase_info(&timebase);
+    
+    return ((double)mach_absolute_time() * timebase.numer / timebase.denom) / 1000000000.0;
+}
+
 void DGSystem::resumeThread(int threadID) {
     if (_areThreadsActive) {
         switch (threadID) {
@@ -289,7 +319,10 @@ void DGSystem::resumeThread(int threadID) {
                 break;
             case DGVideoThread:
                 dispatch_resume(_videoThread);
-                break;                
+                break;
+            case DGTextureThread:
+                dispatch_semaphore_signal(_semaphores[DGTextureThread]);
+                break;
         }
     }
 }
@@ -315,8 +348,22 @@ void DGSystem::setTitle(const char* title) {
     [pool release];
 }
 
+void DGSystem::signalThread(int threadID) {
+    // Only the loaders wait for each other, so one signal each
+    if (_areThreadsActive && (threadID == DGTextureThread)) {
+        for (int i = 0; i < DGNumberOfLoaders; i++)
+            dispatch_semaphore_signal(_textureSignal);
+    }
+}
+
 void DGSystem::suspendThread(int threadID) {
     if (_areThreadsActive) {
+        // The loaders are never suspended, we simply hold the lock
+        if (threadID == DGTextureThread) {
+            dispatch_semaphore_wait(_semaphores[DGTextureThread], DISPATCH_TIME_FOREVER);
+            return;
+        }
+        
         dispatch_semaphore_wait(_semaphores[threadID], DISPATCH_TIME_FOREVER);
         
         switch (threadID) {
@@ -444,6 +491,16 @@ void DGSystem::update() {
     [view update];
 }
 
+void DGSystem::waitForThread(int threadID) {
+    if (_areThreadsActive && (threadID == DGTextureThread)) {
+        // Signals left from earlier only wake us early, and the timeout
+        // covers one taken by a loader that wasn't waiting
+        dispatch_semaphore_signal(_semaphores[DGTextureThread]);
+        dispatch_semaphore_wait(_textureSignal, dispatch_time(DISPATCH_TIME_NOW, 10000000));
+        dispatch_semaphore_wait(_semaphores[DGTextureThread], DISPATCH_TIME_FOREVER);
+    }
+}
+
 time_t DGSystem::wallTime() {
     dispatch_time_t now = dispatch_time(DISPATCH_TIME_NOW, NULL);
     return (now / 1000);
@@ -18,6 +18,7 @@
 #include <GL/glx.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "DGAudioManager.h"
 #include "DGConfig.h"
@@ -25,6 +26,7 @@
 #include "DGLog.h"
 #include "DGPlatform.h"
 #include "DGSystem.h"
+#include "DGTextureManager.h"
 #include "DGTimerManager.h"
 #include "DGVideoManager.h"
 
@@ -69,18 +71,23 @@ GLWindow GLWin;
 pthread_t tAudioThread;
 pthread_t tProfilerThread;
 pthread_t tSystemThread;
+pthread_t tTextureThreads[DGNumberOfLoaders];
 pthread_t tTimerThread;
 pthread_t tVideoThread;
 
 static pthread_mutex_t _audioMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t _systemMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t _textureMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t _timerMutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t _videoMutex = PTHREAD_MUTEX_INITIALIZER;
 
+static pthread_cond_t _textureCondition = PTHREAD_COND_INITIALIZER;
+
 void* _audioThread(void *arg);
 void* _profilerThread(void *arg);
 void* _systemThread(void *arg);
 void* _systemThread(void *arg);
+void* _textureThread(void *arg);
 void* _timerThread(void *arg);
 void* _videoThread(void *arg);
 
@@ -127,6 +134,9 @@ void DGSystem::createThreads() {
 	pthread_create(&tTimerThread, NULL, &_timerThread, NULL);
 	pthread_create(&tVideoThread, NULL, &_videoThread, NULL);
 
+	for (int i = 0; i < DGNumberOfLoaders; i++)
+		pthread_create(&tTextureThreads[i], NULL, &_textureThread, NULL);
+
 	if (config->debugMode)
 		pthread_create(&tProfilerThread, NULL, &_profilerThread, NULL);
 
@@ -146,6 +156,10 @@ void DGSystem::destroyThreads() {
 	DGVideoManager::getInstance().terminate();
 	pthread_mutex_unlock(&_videoMutex);
 
+	pthread_mutex_lock(&_textureMutex);
+	DGTextureManager::getInstance().terminate();
+	pthread_mutex_unlock(&_textureMutex);
+
 	_areThreadsActive = false;
 }
 
@@ -180,6 +194,14 @@ void DGSystem::init() {
     else log->warning(DGModSystem, "%s", DGMsg140002);
 }
 
+double DGSystem::monotonicTime() {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (double)now.tv_sec + ((double)now.tv_nsec / 1000000000.0);
+}
+
 void DGSystem::resumeThread(int threadID){
     if (_areThreadsActive) {
         switch (threadID) {
@@ -191,7 +213,10 @@ void DGSystem::resumeThread(int threadID){
                 break;
             case DGVideoThread:
                 pthread_mutex_unlock(&_videoMutex);
-                break;                
+                break;
+            case DGTextureThread:
+                pthread_mutex_unlock(&_textureMutex);
+                break;
         }
     }
 }
@@ -306,6 +331,12 @@ void DGSystem::setTitle(const char* title) {
 
 }
 
+void DGSystem::signalThread(int threadID) {
+    // Only the loaders wait for each other
+    if (_areThreadsActive && (threadID == DGTextureThread))
+        pthread_cond_broadcast(&_textureCondition);
+}
+
 void DGSystem::suspendThread(int threadID) {
     if (_areThreadsActive) {
         switch (threadID) {
@@ -317,7 +348,10 @@ void DGSystem::suspendThread(int threadID) {
                 break;
             case DGVideoThread:
                 pthread_mutex_lock(&_videoMutex);
-                break;                
+                break;
+            case DGTextureThread:
+                pthread_mutex_lock(&_textureMutex);
+                break;
         }
     }
 }
@@ -336,6 +370,11 @@ void DGSystem::update() {
 	glXSwapBuffers(GLWin.dpy, GLWin.win);
 }
 
+void DGSystem::waitForThread(int threadID) {
+    if (_areThreadsActive && (threadID == DGTextureThread))
+        pthread_cond_wait(&_textureCondition, &_textureMutex);
+}
+
 time_t DGSystem::wallTime() {
 	// FIXME: Confirm this works with several threads
 	return clock();
@@ -560,6 +599,19 @@ void* _systemThread(void *arg) {
 	return 0;
 }
 
+// The loaders don't hold their mutex while decoding, otherwise the
+// controller would block on every request. Instead, the texture
+// manager locks it only to access its queues, and waits on it when
+// there's nothing to do.
+void* _textureThread(void *arg) {
+	bool isRunning = true;
+
+	while (isRunning)
+		isRunning = DGTextureManager::getInstance().update();
+
+	return 0;
+}
+
 void* _timerThread(void *arg) {
 	bool isRunning = true;
 	double pause = 100000;
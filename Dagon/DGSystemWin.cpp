@@ -21,6 +21,7 @@
 #include "DGLog.h"
 #include "DGPlatform.h"
 #include "DGSystem.h"
+#include "DGTextureManager.h"
 #include "DGTimerManager.h"
 #include "DGVideoManager.h"
 
@@ -41,17 +42,22 @@ HGLRC g_hRC = NULL;
 HANDLE hAudioThread;
 HANDLE hProfilerThread;
 HANDLE hSystemThread;
+HANDLE hTextureThreads[DGNumberOfLoaders];
 HANDLE hTimerThread;
 HANDLE hVideoThread;
 
 CRITICAL_SECTION csAudioThread;
 CRITICAL_SECTION csSystemThread;
+CRITICAL_SECTION csTextureThread;
 CRITICAL_SECTION csTimerThread;
 CRITICAL_SECTION csVideoThread;
 
+CONDITION_VARIABLE cvTextureThread;
+
 DWORD WINAPI _audioThread(LPVOID lpParam);
 DWORD WINAPI _profilerThread(LPVOID lpParam);
 DWORD WINAPI _systemThread(LPVOID lpParam);
+DWORD WINAPI _textureThread(LPVOID lpParam);
 DWORD WINAPI _timerThread(LPVOID lpParam);
 DWORD WINAPI _videoThread(LPVOID lpParam);
 LRESULT CALLBACK _WindowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -115,6 +121,11 @@ void DGSystem::createThreads() {
 	InitializeCriticalSection(&csVideoThread);
 	hVideoThread = CreateThread(NULL, 0, _videoThread, NULL, 0, NULL);
 
+	InitializeCriticalSection(&csTextureThread);
+	InitializeConditionVariable(&cvTextureThread);
+	for (int i = 0; i < DGNumberOfLoaders; i++)
+		hTextureThreads[i] = CreateThread(NULL, 0, _textureThread, NULL, 0, NULL);
+
 	if (config->debugMode) {
 		hProfilerThread = CreateThread(NULL, 0, _profilerThread, NULL, 0, NULL);
 	}
@@ -147,6 +158,14 @@ void DGSystem::destroyThreads() {
 		DeleteCriticalSection(&csVideoThread);
 	}
 
+	if (hTextureThreads[0] != NULL) {
+		EnterCriticalSection(&csTextureThread);
+		DGTextureManager::getInstance().terminate();
+		LeaveCriticalSection(&csTextureThread);
+		WaitForMultipleObjects(DGNumberOfLoaders, hTextureThreads, TRUE, INFINITE);
+		DeleteCriticalSection(&csTextureThread);
+	}
+
 	_areThreadsActive = false;
 }
 
@@ -243,6 +262,18 @@ void DGSystem::init() {
     else log->warning(DGModSystem, "%s", DGMsg140002);
 }
 
+double DGSystem::monotonicTime() {
+    static LARGE_INTEGER frequency = {0};
+    LARGE_INTEGER now;
+    
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+    
+    QueryPerformanceCounter(&now);
+    
+    return (double)now.QuadPart / (double)frequency.QuadPart;
+}
+
 void DGSystem::resumeThread(int threadID){
     if (_areThreadsActive) {
         switch (threadID) {
@@ -254,7 +285,10 @@ void DGSystem::resumeThread(int threadID){
                 break;
             case DGVideoThread:
                 LeaveCriticalSection(&csVideoThread);
-                break;                
+                break;
+            case DGTextureThread:
+                LeaveCriticalSection(&csTextureThread);
+                break;
         }
     }
 }
@@ -295,6 +329,12 @@ void DGSystem::setTitle(const char* title) {
     SetWindowText(g_hWnd, str);*/
 }
 
+void DGSystem::signalThread(int threadID) {
+    // Only the loaders wait for each other
+    if (_areThreadsActive && (threadID == DGTextureThread))
+        WakeAllConditionVariable(&cvTextureThread);
+}
+
 void DGSystem::suspendThread(int threadID){
     if (_areThreadsActive) {
         switch (threadID) {
@@ -306,7 +346,10 @@ void DGSystem::suspendThread(int threadID){
                 break;
             case DGVideoThread:
                 EnterCriticalSection(&csVideoThread);
-                break;                
+                break;
+            case DGTextureThread:
+                EnterCriticalSection(&csTextureThread);
+                break;
         }
     }
 }
@@ -399,6 +442,11 @@ void DGSystem::update() {
     SwapBuffers(g_hDC);
 }
 
+void DGSystem::waitForThread(int threadID) {
+    if (_areThreadsActive && (threadID == DGTextureThread))
+        SleepConditionVariableCS(&cvTextureThread, &csTextureThread, INFINITE);
+}
+
 time_t DGSystem::wallTime() {
 	FILETIME ft;
 	LARGE_INTEGER li;
@@ -463,6 +511,18 @@ DWORD WINAPI _systemThread(LPVOID lpParam) {
 	return 0;
 }
 
+// The loaders don't hold their critical section while decoding,
+// the texture manager enters it only to access its queues, and
+// waits on it when there's nothing to do
+DWORD WINAPI _textureThread(LPVOID lpParam) {
+	bool isRunning = true;
+
+	while (isRunning)
+		isRunning = DGTextureManager::getInstance().update();
+	
+	return 0;
+}
+
 DWORD WINAPI _timerThread(LPVOID lpParam) {
 	DWORD dwPause = 100;
 	bool isRunning = true;
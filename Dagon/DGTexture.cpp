@@ -18,6 +18,7 @@
 #include "DGLanguage.h"
 #include "DGLog.h"
 #include "DGTexture.h"
+#include "DGTextureManager.h"
 #include "stb_image.h"
 
 ////////////////////////////////////////////////////////////
@@ -27,6 +28,17 @@
 //char TEXIdent[] = "DG_TEX"; // Tex files identifier
 char TEXIdent[] = "KS_TEX"; // Tex files identifier
 
+// Faces are ordered as directions, and the cube map is addressed
+// with the Z axis inverted (see DGRenderManager::drawCubeMap)
+static const GLenum DGCubeMapTargets[DGNumberOfFaces] = {
+    GL_TEXTURE_CUBE_MAP_POSITIVE_Z, // North
+    GL_TEXTURE_CUBE_MAP_POSITIVE_X, // East
+    GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, // South
+    GL_TEXTURE_CUBE_MAP_NEGATIVE_X, // West
+    GL_TEXTURE_CUBE_MAP_POSITIVE_Y, // Up
+    GL_TEXTURE_CUBE_MAP_NEGATIVE_Y  // Down
+};
+
 ////////////////////////////////////////////////////////////
 // Implementation - Constructor
 ////////////////////////////////////////////////////////////
@@ -37,9 +49,45 @@ DGTexture::DGTexture() {
     config = &DGConfig::getInstance();
     log = &DGLog::getInstance();
 
+    _bitmap = NULL;
+    _cacheFile[0] = '\0';
     _compressionLevel = config->texCompression;
+    _distance = 0;
+    _firstLevel = 0;
+    _width = 0;
+    _height = 0;
+    _depth = 0;
+    _hash = 0;
+    _hasPreview = false;
     _hasResource = false;
+    _ident = 0;
+    _indexInBundle = 0;
+    _isCubeMap = false;
+    _isFace = false;
 	_isLoaded = false;
+    _isMapped = false;
+    _isPrecompressed = false;
+    _nextFace = 0;
+    _nextLevel = 0;
+    _nextRow = 0;
+    _numLevels = 1;
+    _numShares = 0;
+    _original = NULL;
+    _previewIdent = 0;
+    _priority = 0.0f;
+    _resolution = 0;
+    _size = 0;
+    _state = DGTextureIdle;
+    _uploadClass = 0;
+    
+    _isActive = false;
+    _nextActive = NULL;
+    _previousActive = NULL;
+    
+    for (int i = 0; i < DGNumberOfFaces; i++) {
+        _cubeFaces[i] = NULL;
+        _isFaceMapped[i] = false;
+    }
     
     _usageCount = 0;
 }
@@ -66,19 +114,51 @@ DGTexture::DGTexture(int width, int height, int depth) {
     glGenTextures(1, &_ident);
     glBindTexture(GL_TEXTURE_2D, _ident);
     glTexImage2D(GL_TEXTURE_2D, 0, comp, width, height,
-                 0, GL_RGB, GL_UNSIGNED_BYTE, _bitmap);
+                 0, (comp == 4) ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, _bitmap);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
     free(_bitmap);
+    _bitmap = NULL;
     
+    _cacheFile[0] = '\0';
     _compressionLevel = config->texCompression;
+    _distance = 0;
+    _firstLevel = 0;
     
     // The texture doesn't require a resource, so we make it clear
+    _hash = 0;
+    _hasPreview = false;
     _hasResource = true;
+    _indexInBundle = 0;
+    _isCubeMap = false;
+    _isFace = false;
     _isLoaded = true;
+    _isMapped = false;
+    _isPrecompressed = false;
+    _nextFace = 0;
+    _nextLevel = 0;
+    _nextRow = 0;
+    _numLevels = 1;
+    _numShares = 0;
+    _original = NULL;
+    _previewIdent = 0;
+    _priority = 0.0f;
+    _resolution = 0;
+    _size = 0;
+    _state = DGTextureIdle;
+    _uploadClass = 0;
+    
+    _isActive = false;
+    _nextActive = NULL;
+    _previousActive = NULL;
+    
+    for (int i = 0; i < DGNumberOfFaces; i++) {
+        _cubeFaces[i] = NULL;
+        _isFaceMapped[i] = false;
+    }
     
     // Since the texture will be loaded only once, we note this
     _usageCount = 1;
@@ -96,14 +176,26 @@ DGTexture::~DGTexture() {
 // Implementation - Checks
 ////////////////////////////////////////////////////////////
 
+bool DGTexture::hasPreview() {
+    return _hasPreview;
+}
+
 bool DGTexture::hasResource() {
     return _hasResource;
 }
 
+bool DGTexture::isCubeMap() {
+    return _isCubeMap;
+}
+
 bool DGTexture::isLoaded() {
     return _isLoaded;
 }
 
+bool DGTexture::isPending() {
+    return (_state != DGTextureIdle);
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - Gets
 ////////////////////////////////////////////////////////////
@@ -124,6 +216,23 @@ const char* DGTexture::resource() {
     return _resource;
 }
 
+long DGTexture::size() {
+    int faces = _isCubeMap ? DGNumberOfFaces : 1;
+    
+    if (_isLoaded)
+        return _size;
+    
+    // Drivers usually pad RGB to four bytes
+    if (_width && _height)
+        return (long)_width * _height * 4 * faces;
+    else
+        return (long)DGDefTexSize * DGDefTexSize * 4 * faces;
+}
+
+int DGTexture::state() {
+    return _state;
+}
+
 
 unsigned int DGTexture::usageCount() {
     return _usageCount;
@@ -139,11 +248,15 @@ int DGTexture::width() {
 
 void DGTexture::increaseUsageCount() {
     // We only keep trace of the usage count if the
-    // texture is loaded
-    if (_isLoaded)
+    // texture is loaded or about to be
+    if (_isLoaded || _state != DGTextureIdle)
         _usageCount++;
 }
 
+void DGTexture::setCubeMap(bool enabled) {
+    _isCubeMap = enabled;
+}
+
 void DGTexture::setIndexInBundle(int index) {
     _indexInBundle = index;
 }
@@ -153,13 +266,19 @@ void DGTexture::setResource(const char* fromFileName) {
     _hasResource = true;
 }
 
+void DGTexture::setState(int theState) {
+    _state = theState;
+}
+
 ////////////////////////////////////////////////////////////
 // Implementation - State changes
 ////////////////////////////////////////////////////////////
 
 void DGTexture::bind() {
     if (_isLoaded)
-        glBindTexture(GL_TEXTURE_2D, _ident);
+        glBindTexture(_isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _ident);
+    else if (_hasPreview)
+        glBindTexture(_isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, _previewIdent);
 }
 
 void DGTexture::clear() {
@@ -170,162 +289,125 @@ void DGTexture::clear() {
                  GL_RGB, GL_UNSIGNED_BYTE, _bitmap);
     
     free(_bitmap);
+    _bitmap = NULL;
 }
 
-void DGTexture::load() {
-    FILE* fh;
-    char magic[10]; // Used to identity file types
-    GLint format = 0, internalFormat = 0;
-    
+bool DGTexture::decode() {
     if (_isLoaded)
-        return;
+        return false;
     
     if (!_hasResource) {
         log->error(DGModTexture, "%s: %s", DGMsg210004, this->name());
         
-        return;
+        return false;
     }
     
-    fh = fopen(_resource, "rb");	
-    
-    if (fh != NULL) {
-        if (fread(&magic, sizeof(magic), 1, fh) == 0) {
-            // Couldn't read magic number
-            log->error(DGModTexture, "%s: %s", DGMsg210002, _resource);
-        }
-        
-        if (memcmp(TEXIdent, &magic, 7) == 0) {
-            short numTextures = 0;
-            
-            TEXMainHeader header;
-            TEXSubHeader subheader;
-            GLint compressed, size;
-            
-            fseek(fh, 8, SEEK_SET); // Skip identifier
-            if (!fread(&header, 1, sizeof(header), fh))
-                return;
-            numTextures = header.numTextures;
-            _width = (GLuint)header.width;
-            _height = (GLuint)header.height;
-            
-            // Skip subheaders based on the index
-            if (_indexInBundle) {
-                unsigned int i;
-                
-                for (i = 0; i < _indexInBundle; i++) {
-                    if (!fread(&subheader, 1, sizeof(subheader), fh))
-                        return;
-                    fseek(fh, sizeof(char) * subheader.size, SEEK_CUR);
-                }
-            }
-            
-            if (!fread(&subheader, 1, sizeof(subheader), fh))
-                return;
-            
-            _depth = (GLuint)subheader.depth;
-            size = (GLint)subheader.size;
-            internalFormat = (GLint)subheader.format;
-            
-            _bitmap = (GLubyte*)malloc(size * sizeof(GLubyte)); 
-            if (!fread(_bitmap, 1, sizeof(GLubyte) * size, fh))
-                return;
-            
-            glGenTextures(1, &_ident);
-            glBindTexture(GL_TEXTURE_2D, _ident);
+    if (_isCubeMap) {
+        // Faces are consecutive entries in the bundle and must share
+        // their size and format
+        for (int face = 0; face < DGNumberOfFaces; face++) {
+            _indexInBundle = face;
             
-            if (header.compressionLevel) {
-                glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, _width, _height, 
-                                       0, size, _bitmap);
-                glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+            if (!_decodeImage()) {
+                _releaseFaces();
+                _indexInBundle = 0;
                 
-                if (compressed == GL_TRUE)
-                    _isLoaded = true;
-                else
-                    log->error(DGModTexture, "%s: %s", DGMsg210002, fh);
+                return false;
             }
-            else {
-                glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, _width, _height, 0, GL_RGB, GL_UNSIGNED_BYTE, _bitmap); // Only RGB is supported
-                _isLoaded = true;
-            }
-            
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
             
-            free(_bitmap);
+            _cubeFaces[face] = _bitmap;
+            _isFaceMapped[face] = _isMapped;
+            _bitmap = NULL;
+            _isMapped = false;
         }
-        else {
-            int x, y, comp;
-            
-            fseek(fh, 0, SEEK_SET);
-            _bitmap = (GLubyte*)stbi_load_from_file(fh, &x, &y, &comp, STBI_default);
+        
+        _indexInBundle = 0;
+        _firstLevel = _levelFor(_resolution);
+        _hashContents();
+        
+        return true;
+    }
+    
+    if (!_decodeImage())
+        return false;
+    
+    _firstLevel = _levelFor(_resolution);
+    _hashContents();
+    
+    return true;
+}
+
+void DGTexture::load() {
+    if (_isLoaded)
+        return;
+    
+    if (this->decode())
+        this->upload();
+}
+
+void DGTexture::loadPreview() {
+    GLenum target = _isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    int faces = _isCubeMap ? DGNumberOfFaces : 1;
+    int firstLevel = 0;
+    bool hasIdent = false;
+    
+    if (_isLoaded || _hasPreview || _state != DGTextureIdle || !config->previewSize)
+        return;
+    
+    for (int face = 0; face < faces; face++) {
+        if (_isCubeMap)
+            _indexInBundle = face;
+        
+        // Only mapped bundles, as reading the file would take as long
+        // as loading the whole texture. The same goes for unpacking.
+        if (!_mapBundle(false))
+            break;
+        
+        // The first level that fits, which must be the same for all faces
+        if (!face) {
+            while ((firstLevel < (_numLevels - 1)) &&
+                   (std::max(_width >> firstLevel, _height >> firstLevel) > config->previewSize))
+                firstLevel++;
             
-            if (_bitmap) {
-                _width = x;
-                _height = y;
-                _depth = comp;
-                
-                switch (comp) {
-                    case STBI_grey:
-                        format = GL_LUMINANCE;				
-                        if (_compressionLevel)							
-                            internalFormat = GL_COMPRESSED_LUMINANCE;						
-                        else						
-                            internalFormat = GL_LUMINANCE;
-                        break;
-                    case STBI_grey_alpha:
-                        format = GL_LUMINANCE_ALPHA;					
-                        if (_compressionLevel)
-                            internalFormat = GL_COMPRESSED_LUMINANCE_ALPHA;							
-                        else						
-                            internalFormat = GL_LUMINANCE_ALPHA;
-                        break;
-                    case STBI_rgb:
-                        format = GL_RGB;					
-                        if (_compressionLevel)					
-                            internalFormat = GL_COMPRESSED_RGB;							
-                        else						
-                            internalFormat = GL_RGB;
-                        break;
-                    case STBI_rgb_alpha:
-                        format = GL_RGBA;						
-                        if (_compressionLevel)						
-                            internalFormat = GL_COMPRESSED_RGBA;						
-                        else						
-                            internalFormat = GL_RGBA;
-                        break;
-                    default:
-                        log->warning(DGModTexture, "%s: (%s) %d", DGMsg210003, _resource, comp);
-                        break;
-                }
-                
-                glGenTextures(1, &_ident);
-                glBindTexture(GL_TEXTURE_2D, _ident);
-                
-                glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, _width, _height,
-                             0, format, GL_UNSIGNED_BYTE, _bitmap);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-                
-                free(_bitmap);
-                
-                _isLoaded = true;
-            }
-            else {
-                // Nothing loaded
-                log->error(DGModTexture, "%s: (%s) %s", DGMsg210001, _resource, stbi_failure_reason());
+            if (std::max(_width >> firstLevel, _height >> firstLevel) > config->previewSize) {
+                _releaseBitmap();
+                break;
             }
+            
+            glGenTextures(1, &_previewIdent);
+            glBindTexture(target, _previewIdent);
+            hasIdent = true;
         }
         
-        fclose(fh);
+        _uploadImage(_isCubeMap ? DGCubeMapTargets[face] : GL_TEXTURE_2D, firstLevel);
+        _releaseBitmap();
+        
+        if (face == (faces - 1))
+            _hasPreview = true;
     }
-    else {
-        // File not found
-        log->error(DGModTexture, "%s: %s", DGMsg210000, _resource);
-    }    
+    
+    if (_isCubeMap)
+        _indexInBundle = 0;
+    
+    if (!_hasPreview) {
+        // Some face is missing, so the preview is useless
+        if (hasIdent)
+            glDeleteTextures(1, &_previewIdent);
+        
+        return;
+    }
+    
+    if ((_numLevels - firstLevel) > 1) {
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, _numLevels - firstLevel - 1);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    else glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    if (_isCubeMap)
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 }
 
 void DGTexture::loadFromMemory(const unsigned char* dataToLoad, long size) {
@@ -382,6 +464,7 @@ void DGTexture::loadFromMemory(const unsigned char* dataToLoad, long size) {
         
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, _width, _height,
                      0, format, GL_UNSIGNED_BYTE, _bitmap);
+        DGTextureManager::getInstance().chargeUpload((long)_width * _height * _depth);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -390,6 +473,7 @@ void DGTexture::loadFromMemory(const unsigned char* dataToLoad, long size) {
         _isLoaded = true;
         
         free(_bitmap);
+        _bitmap = NULL;
     }
     else {
         // Nothing loaded
@@ -422,6 +506,9 @@ void DGTexture::loadRawData(const unsigned char* dataToLoad, int width, int heig
         glBindTexture(GL_TEXTURE_2D, _ident);
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, dataToLoad);
     }
+    
+    // Frames can't wait, but others can
+    DGTextureManager::getInstance().chargeUpload((long)width * height * 3);
 }
 
 // NOTE: Always saves in TGA format
@@ -433,9 +520,10 @@ void DGTexture::saveToFile(const char* fileName){
         strncpy(fullFileName, fileName, DGMaxFileLength - 4);
         
         if (_compressionLevel) {
-            TEXMainHeader header;
-            TEXSubHeader subheader;
+            TEXMainHeaderV2 header;
+            TEXEntry entry;
             GLint internalformat, size;
+            char ident[8];
              
             // TODO: Must check that the texture is RGB
             // NOTE: Let's try to support alpha channel for these textures
@@ -445,28 +533,44 @@ void DGTexture::saveToFile(const char* fileName){
             glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
             _bitmap = (GLubyte*)malloc(size * sizeof(GLubyte)); 
             glGetCompressedTexImage(GL_TEXTURE_2D, 0, _bitmap);
+            
+            memset(ident, 0, sizeof(ident));
+            memset(&header, 0, sizeof(header));
+            memset(&entry, 0, sizeof(entry));
+            
+            strncpy(ident, TEXIdentV2, sizeof(ident));
+            strncpy(header.name, this->name(), sizeof(header.name) - 1); // This is the object name
+            header.version = TEXVersion;
+            header.numTextures = 1;
             header.compressionLevel = 1;
              
-            strcpy(header.name, this->name()); // This is the object name
-            header.width = (short)_width;
-            header.height = (short)_height;
-            header.numTextures = 0;
-             
-            subheader.cubePosition = 0;
-            subheader.depth = (short)_depth;
-            subheader.size = (int)size;
-            subheader.format = (int)internalformat;
+            entry.width = _width;
+            entry.height = _height;
+            entry.depth = _depth;
+            entry.format = internalformat;
+            entry.numLevels = 1;
+            entry.offset = _alignedOffset(sizeof(ident) + sizeof(header) + sizeof(entry));
+            entry.size = size;
+            entry.levelSize[0] = size;
             
             strncat(fullFileName, ".tex", 4);
             
             fh = fopen(fullFileName, "wb");
-            fwrite(&TEXIdent, 1, 8, fh);
-            fwrite(&header, 1, sizeof(header), fh);
-            fwrite(&subheader, 1, sizeof(subheader), fh);
-            fwrite(_bitmap, 1, sizeof(GLubyte) * size, fh);
+            if (fh != NULL) {
+                fwrite(ident, 1, sizeof(ident), fh);
+                fwrite(&header, 1, sizeof(header), fh);
+                fwrite(&entry, 1, sizeof(entry), fh);
+                
+                // Pad until the payload
+                while (ftell(fh) < (long)entry.offset)
+                    fputc(0, fh);
+                
+                fwrite(_bitmap, 1, sizeof(GLubyte) * size, fh);
+                fclose(fh);
+            }
              
             free(_bitmap);
-            fclose(fh);
+            _bitmap = NULL;
         }
         else {
             unsigned char cGarbage = 0, type, mode;
@@ -533,14 +637,710 @@ void DGTexture::saveToFile(const char* fileName){
             fclose(fh);
             
             free(_bitmap);
+            _bitmap = NULL;
+        }
+    }
+}
+
+bool DGTexture::stream() {
+    DGTextureManager* textureManager = &DGTextureManager::getInstance();
+    GLenum target = _isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    int faces = _isCubeMap ? DGNumberOfFaces : 1;
+    
+    if (!_ident) {
+        if (_isCubeMap ? !_cubeFaces[0] : !_bitmap)
+            return true;
+        
+        glGenTextures(1, &_ident);
+        
+        _nextFace = 0;
+        _nextLevel = _firstLevel;
+        _nextRow = 0;
+        _size = 0;
+    }
+    
+    glBindTexture(target, _ident);
+    
+    while (_nextFace < faces) {
+        GLenum faceTarget = _isCubeMap ? DGCubeMapTargets[_nextFace] : GL_TEXTURE_2D;
+        GLubyte* data = _isCubeMap ? _cubeFaces[_nextFace] : _bitmap;
+        GLint width = std::max(_width >> _nextLevel, 1);
+        GLint height = std::max(_height >> _nextLevel, 1);
+        GLint levelSize = _levelSize[_nextLevel];
+        const GLvoid* pixels;
+        
+        for (int level = 0; level < _nextLevel; level++)
+            data += _levelSize[level];
+        
+        if (_isPrecompressed || _compressionLevel) {
+            // Compressed levels must go whole
+            if (!textureManager->beginUpload(data, levelSize, &pixels))
+                return false;
+            
+            if (_isPrecompressed) {
+                glCompressedTexImage2D(faceTarget, _nextLevel - _firstLevel, _internalFormat,
+                                       width, height, 0, levelSize, pixels);
+                _size += levelSize;
+            }
+            else {
+                glTexImage2D(faceTarget, _nextLevel - _firstLevel, _internalFormat, width, height,
+                             0, _format, GL_UNSIGNED_BYTE, pixels);
+                _size += _storedSize(faceTarget, _nextLevel - _firstLevel, width, height);
+            }
+            
+            textureManager->endUpload();
+            _nextRow = height;
+        }
+        else {
+            // Otherwise a few rows at a time, so big levels take a few frames
+            GLint rowSize = levelSize / height;
+            GLint rows = std::min(std::max((GLint)(textureManager->uploadBytes() / rowSize), 1),
+                                  height - _nextRow);
+            
+            // Allocated before binding a buffer, which would take the place of the data
+            if (!_nextRow && (rows < height))
+                glTexImage2D(faceTarget, _nextLevel - _firstLevel, _internalFormat, width, height,
+                             0, _format, GL_UNSIGNED_BYTE, NULL);
+            
+            if (!textureManager->beginUpload(data + (_nextRow * rowSize), rows * rowSize, &pixels))
+                return false;
+            
+            if (rows == height)
+                glTexImage2D(faceTarget, _nextLevel - _firstLevel, _internalFormat, width, height,
+                             0, _format, GL_UNSIGNED_BYTE, pixels);
+            else
+                glTexSubImage2D(faceTarget, _nextLevel - _firstLevel, 0, _nextRow, width, rows,
+                                _format, GL_UNSIGNED_BYTE, pixels);
+            
+            textureManager->endUpload();
+            _nextRow += rows;
+            
+            if (_nextRow == height)
+                _size += _storedSize(faceTarget, _nextLevel - _firstLevel, width, height);
+        }
+        
+        if (_nextRow == height) {
+            _nextRow = 0;
+            _nextLevel++;
+            
+            if (_nextLevel == _numLevels) {
+                _nextLevel = _firstLevel;
+                _nextFace++;
+            }
+        }
+    }
+    
+    _releaseBitmap();
+    _releaseFaces();
+    
+    _complete(target);
+    
+    return true;
+}
+
+void DGTexture::upload() {
+    GLenum target = _isCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    
+    if (_isCubeMap ? !_cubeFaces[0] : !_bitmap)
+        return;
+    
+    glGenTextures(1, &_ident);
+    glBindTexture(target, _ident);
+    
+    _size = 0;
+    
+    if (_isCubeMap) {
+        for (int face = 0; face < DGNumberOfFaces; face++) {
+            _bitmap = _cubeFaces[face];
+            _isMapped = _isFaceMapped[face];
+            _cubeFaces[face] = NULL;
+            
+            _uploadImage(DGCubeMapTargets[face], _firstLevel);
+            _releaseBitmap();
         }
     }
+    else {
+        _uploadImage(GL_TEXTURE_2D, _firstLevel);
+        _releaseBitmap();
+    }
+    
+    DGTextureManager::getInstance().chargeUpload(_size);
+    
+    _complete(target);
 }
 
 void DGTexture::unload() {
-    if (_isLoaded) {
+    // Discard decoded data that never made it to the GPU
+    _releaseBitmap();
+    _releaseFaces();
+    _releasePreview();
+    
+    // The GL texture belongs to the original
+    if (_original) {
+        _original->_numShares--;
+        _original = NULL;
+        _ident = 0;
+        _isLoaded = false;
+    }
+    
+    // Including those streamed halfway
+    if (_ident) {
         glDeleteTextures(1, &_ident);
-        _usageCount = 0;
+        _ident = 0;
         _isLoaded = false;
+        _size = 0;
+    }
+    
+    _usageCount = 0;
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Private methods
+////////////////////////////////////////////////////////////
+
+uint32_t DGTexture::_alignedOffset(uint32_t offset) {
+    return (offset + TEXAlignment - 1) & ~(TEXAlignment - 1);
+}
+
+// Checks the upload and sets up the texture once all levels are in
+void DGTexture::_complete(GLenum target) {
+    if (_isPrecompressed) {
+        GLint compressed;
+        
+        glGetTexLevelParameteriv(_isCubeMap ? DGCubeMapTargets[0] : GL_TEXTURE_2D, 0,
+                                 GL_TEXTURE_COMPRESSED, &compressed);
+        
+        if (compressed == GL_TRUE)
+            _isLoaded = true;
+        else
+            log->error(DGModTexture, "%s: %s", DGMsg210002, _resource);
+    }
+    else _isLoaded = true;
+    
+    if (_isLoaded && _cacheFile[0])
+        _storeInCache();
+    
+    if ((_numLevels - _firstLevel) > 1) {
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, _numLevels - _firstLevel - 1);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    else glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    if (_isCubeMap)
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    
+    // The full texture takes its place from now on
+    if (_isLoaded)
+        _releasePreview();
+}
+
+bool DGTexture::_decodeImage() {
+    FILE* fh;
+    char magic[10]; // Used to identity file types
+    
+    _cacheFile[0] = '\0';
+    
+    // Version 2 bundles are uploaded straight from memory
+    if (_mapBundle())
+        return true;
+    
+    fh = fopen(_resource, "rb");	
+    
+    if (fh != NULL) {
+        if (fread(&magic, sizeof(magic), 1, fh) == 0) {
+            // Couldn't read magic number
+            log->error(DGModTexture, "%s: %s", DGMsg210002, _resource);
+        }
+        
+        if (memcmp(TEXIdentV2, &magic, 7) == 0) {
+            if (!_readBundle(fh)) {
+                log->error(DGModTexture, "%s: %s", DGMsg210002, _resource);
+                
+                if (_bitmap) {
+                    free(_bitmap);
+                    _bitmap = NULL;
+                }
+            }
+        }
+        else if (memcmp(TEXIdent, &magic, 7) == 0) {
+            TEXMainHeader header;
+            TEXSubHeader subheader;
+            
+            fseek(fh, 8, SEEK_SET); // Skip identifier
+            if (!fread(&header, 1, sizeof(header), fh)) {
+                fclose(fh);
+                return false;
+            }
+            
+            // Only version 2 bundles are packed
+            if (header.compressionLevel > 1) {
+                log->error(DGModTexture, "%s: %s", DGMsg210006, _resource);
+                fclose(fh);
+                return false;
+            }
+            
+            _width = (GLuint)header.width;
+            _height = (GLuint)header.height;
+            
+            // Skip subheaders based on the index
+            if (_indexInBundle) {
+                int i;
+                
+                for (i = 0; i < _indexInBundle; i++) {
+                    if (!fread(&subheader, 1, sizeof(subheader), fh)) {
+                        fclose(fh);
+                        return false;
+                    }
+                    fseek(fh, sizeof(char) * subheader.size, SEEK_CUR);
+                }
+            }
+            
+            if (!fread(&subheader, 1, sizeof(subheader), fh)) {
+                fclose(fh);
+                return false;
+            }
+            
+            _depth = (GLuint)subheader.depth;
+            _bitmapSize = (GLint)subheader.size;
+            _format = GL_RGB; // Only RGB is supported
+            _internalFormat = (GLint)subheader.format;
+            _isPrecompressed = (header.compressionLevel > 0);
+            _levelSize[0] = _bitmapSize;
+            _numLevels = 1;
+            
+            _bitmap = (GLubyte*)malloc(_bitmapSize * sizeof(GLubyte)); 
+            if (!fread(_bitmap, 1, sizeof(GLubyte) * _bitmapSize, fh)) {
+                log->error(DGModTexture, "%s: %s", DGMsg210002, _resource);
+                
+                free(_bitmap);
+                _bitmap = NULL;
+            }
+        }
+        else {
+            int x, y, comp;
+            
+            // Compressed by the driver on a previous run
+            if (_compressionLevel && _readCache()) {
+                fclose(fh);
+                return true;
+            }
+            
+            fseek(fh, 0, SEEK_SET);
+            _bitmap = (GLubyte*)stbi_load_from_file(fh, &x, &y, &comp, STBI_default);
+            
+            if (_bitmap) {
+                _width = x;
+                _height = y;
+                _depth = comp;
+                _isPrecompressed = false;
+                _levelSize[0] = x * y * comp;
+                _numLevels = 1;
+                
+                switch (comp) {
+                    case STBI_grey:
+                        _format = GL_LUMINANCE;				
+                        if (_compressionLevel)							
+                            _internalFormat = GL_COMPRESSED_LUMINANCE;						
+                        else						
+                            _internalFormat = GL_LUMINANCE;
+                        break;
+                    case STBI_grey_alpha:
+                        _format = GL_LUMINANCE_ALPHA;					
+                        if (_compressionLevel)
+                            _internalFormat = GL_COMPRESSED_LUMINANCE_ALPHA;							
+                        else						
+                            _internalFormat = GL_LUMINANCE_ALPHA;
+                        break;
+                    case STBI_rgb:
+                        _format = GL_RGB;					
+                        if (_compressionLevel)					
+                            _internalFormat = GL_COMPRESSED_RGB;							
+                        else						
+                            _internalFormat = GL_RGB;
+                        break;
+                    case STBI_rgb_alpha:
+                        _format = GL_RGBA;						
+                        if (_compressionLevel)						
+                            _internalFormat = GL_COMPRESSED_RGBA;						
+                        else						
+                            _internalFormat = GL_RGBA;
+                        break;
+                    default:
+                        log->warning(DGModTexture, "%s: (%s) %d", DGMsg210003, _resource, comp);
+                        break;
+                }
+            }
+            else {
+                // Nothing loaded
+                log->error(DGModTexture, "%s: (%s) %s", DGMsg210001, _resource, stbi_failure_reason());
+            }
+        }
+        
+        fclose(fh);
+    }
+    else {
+        // File not found
+        log->error(DGModTexture, "%s: %s", DGMsg210000, _resource);
+    }
+    
+    return (_bitmap != NULL);
+}
+
+bool DGTexture::_mapBundle(bool canUnpack) {
+    TEXMainHeaderV2 header;
+    TEXEntry entry;
+    GLubyte* data;
+    long size, offset;
+    long unpackedSize = 0;
+    
+    data = DGTextureManager::getInstance().mapBundle(_resource, &size);
+    
+    // Not an error, we simply fall back to reading the file
+    if (!data || (size < 8) || (memcmp(TEXIdentV2, data, 7) != 0))
+        return false;
+    
+    offset = 8 + sizeof(header) + (_indexInBundle * sizeof(entry));
+    if (size < (long)(offset + sizeof(entry)))
+        return false;
+    
+    memcpy(&header, data + 8, sizeof(header));
+    memcpy(&entry, data + offset, sizeof(entry));
+    
+    if ((header.version != TEXVersion) || (_indexInBundle >= (int)header.numTextures))
+        return false;
+    
+    if (!entry.numLevels || (entry.numLevels > TEXMaxLevels) ||
+        ((long)entry.offset + (long)entry.size > size))
+        return false;
+    
+    if ((header.compressionLevel > 1) && !canUnpack)
+        return false;
+    
+    _width = (GLint)entry.width;
+    _height = (GLint)entry.height;
+    _depth = (GLint)entry.depth;
+    _bitmapSize = (GLint)entry.size;
+    _internalFormat = (GLint)entry.format;
+    _isPrecompressed = TEXIsCompressed(header.compressionLevel, entry.format);
+    _numLevels = (int)entry.numLevels;
+    
+    for (int i = 0; i < _numLevels; i++)
+        _levelSize[i] = (GLint)entry.levelSize[i];
+    
+    switch (entry.depth) {
+        case 1: _format = GL_LUMINANCE; break;
+        case 2: _format = GL_LUMINANCE_ALPHA; break;
+        case 4: _format = GL_RGBA; break;
+        default: _format = GL_RGB; break;
+    }
+    
+    if (header.compressionLevel > 1) {
+        for (int i = 0; i < _numLevels; i++)
+            unpackedSize += _levelSize[i];
+        
+        _bitmap = (GLubyte*)malloc(unpackedSize * sizeof(GLubyte));
+        _bitmapSize = (GLint)unpackedSize;
+        
+        if (!DGTextureManager::getInstance().unpack(data + entry.offset, entry.size,
+                                                    _bitmap, unpackedSize)) {
+            log->error(DGModTexture, "%s: %s", DGMsg210005, _resource);
+            
+            free(_bitmap);
+            _bitmap = NULL;
+            
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // No copy at all, the payload is used in place
+    _bitmap = data + entry.offset;
+    _isMapped = true;
+    
+    return true;
+}
+
+bool DGTexture::_readBundle(FILE* fh) {
+    TEXMainHeaderV2 header;
+    TEXEntry entry;
+    
+    fseek(fh, 8, SEEK_SET); // Skip identifier
+    if (!fread(&header, 1, sizeof(header), fh))
+        return false;
+    
+    if ((header.version != TEXVersion) || (_indexInBundle >= (int)header.numTextures))
+        return false;
+    
+    // Go straight to the entry in the directory...
+    fseek(fh, 8 + sizeof(header) + (_indexInBundle * sizeof(entry)), SEEK_SET);
+    if (!fread(&entry, 1, sizeof(entry), fh))
+        return false;
+    
+    if (!entry.numLevels || (entry.numLevels > TEXMaxLevels))
+        return false;
+    
+    _width = (GLint)entry.width;
+    _height = (GLint)entry.height;
+    _depth = (GLint)entry.depth;
+    _bitmapSize = (GLint)entry.size;
+    _internalFormat = (GLint)entry.format;
+    _isPrecompressed = TEXIsCompressed(header.compressionLevel, entry.format);
+    _numLevels = (int)entry.numLevels;
+    
+    for (int i = 0; i < _numLevels; i++)
+        _levelSize[i] = (GLint)entry.levelSize[i];
+    
+    switch (entry.depth) {
+        case 1: _format = GL_LUMINANCE; break;
+        case 2: _format = GL_LUMINANCE_ALPHA; break;
+        case 4: _format = GL_RGBA; break;
+        default: _format = GL_RGB; break;
+    }
+    
+    // ...and then to its payload
+    fseek(fh, entry.offset, SEEK_SET);
+    
+    _bitmap = (GLubyte*)malloc(_bitmapSize * sizeof(GLubyte));
+    if (fread(_bitmap, 1, sizeof(GLubyte) * _bitmapSize, fh) != (size_t)_bitmapSize)
+        return false;
+    
+    if (header.compressionLevel > 1) {
+        GLubyte* payload = _bitmap;
+        long payloadSize = _bitmapSize;
+        
+        _bitmapSize = 0;
+        
+        for (int i = 0; i < _numLevels; i++)
+            _bitmapSize += _levelSize[i];
+        
+        _bitmap = (GLubyte*)malloc(_bitmapSize * sizeof(GLubyte));
+        
+        bool isUnpacked = DGTextureManager::getInstance().unpack(payload, payloadSize,
+                                                                 _bitmap, _bitmapSize);
+        
+        free(payload);
+        
+        return isUnpacked;
+    }
+    
+    return true;
+}
+
+// Looks for the image in the cache of compressed textures, noting where
+// to store it otherwise
+bool DGTexture::_readCache() {
+    FILE* fh;
+    char ident[8];
+    bool isRead;
+    
+    if (!DGTextureManager::getInstance().findCachedImage(_resource, _cacheFile))
+        return false;
+    
+    fh = fopen(_cacheFile, "rb");
+    
+    if (!fh)
+        return false;
+    
+    isRead = fread(ident, 1, sizeof(ident), fh) && (memcmp(TEXIdentV2, ident, 7) == 0) &&
+             _readBundle(fh);
+    
+    fclose(fh);
+    
+    if (!isRead) {
+        // Compressed and stored again
+        if (_bitmap) {
+            free(_bitmap);
+            _bitmap = NULL;
+        }
+        
+        return false;
+    }
+    
+    _cacheFile[0] = '\0';
+    
+    return true;
+}
+
+// Mixes in the format as well, since the same data means something else
+// with a different size or format
+void DGTexture::_hashContents() {
+    GLint format[] = {_width, _height, _internalFormat, _numLevels, _firstLevel, _isCubeMap};
+    int faces = _isCubeMap ? DGNumberOfFaces : 1;
+    long skipped = 0, size = 0;
+    
+    // Only what is uploaded, so that skipped levels are never read
+    for (int level = 0; level < _numLevels; level++) {
+        if (level < _firstLevel)
+            skipped += _levelSize[level];
+        else
+            size += _levelSize[level];
+    }
+    
+    _hash = TEXHash((const unsigned char*)format, sizeof(format), 14695981039346656037ULL);
+    
+    for (int face = 0; face < faces; face++) {
+        const GLubyte* data = _isCubeMap ? _cubeFaces[face] : _bitmap;
+        
+        if (!data) {
+            _hash = 0;
+            return;
+        }
+        
+        _hash = TEXHash(data + skipped, size, _hash);
+    }
+}
+
+// The texture is drawn as a preview while a bigger one is loaded
+void DGTexture::_keepAsPreview() {
+    _releasePreview();
+    
+    _hasPreview = true;
+    _previewIdent = _ident;
+    
+    _ident = 0;
+    _isLoaded = false;
+    _size = 0;
+}
+
+// The smallest level that still has a texel for every pixel of the face
+int DGTexture::_levelFor(int resolution) {
+    int level = 0;
+    
+    if (!resolution)
+        return 0;
+    
+    while ((level < (_numLevels - 1)) && ((std::max(_width, _height) >> (level + 1)) >= resolution))
+        level++;
+    
+    return level;
+}
+
+void DGTexture::_releaseBitmap() {
+    if (_bitmap) {
+        if (!_isMapped)
+            free(_bitmap);
+        
+        _bitmap = NULL;
+        _isMapped = false;
+    }
+}
+
+void DGTexture::_releaseFaces() {
+    for (int face = 0; face < DGNumberOfFaces; face++) {
+        if (_cubeFaces[face]) {
+            if (!_isFaceMapped[face])
+                free(_cubeFaces[face]);
+            
+            _cubeFaces[face] = NULL;
+            _isFaceMapped[face] = false;
+        }
+    }
+}
+
+void DGTexture::_releasePreview() {
+    if (_hasPreview) {
+        glDeleteTextures(1, &_previewIdent);
+        _hasPreview = false;
+    }
+}
+
+GLint DGTexture::_storedSize(GLenum target, int level, GLint width, GLint height) {
+    GLint compressed = GL_FALSE;
+    
+    if (_compressionLevel)
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED, &compressed);
+    
+    // Only the driver knows the size after compressing
+    if (compressed == GL_TRUE) {
+        GLint size;
+        
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        return size;
+    }
+    
+    return width * height * ((_depth == 3) ? 4 : _depth);
+}
+
+// Takes the GL texture of another one with the same contents, dropping
+// the decoded data instead of uploading it
+void DGTexture::_share(DGTexture* original) {
+    _releaseBitmap();
+    _releaseFaces();
+    _releasePreview();
+    
+    _ident = original->_ident;
+    _isLoaded = true;
+    _original = original;
+    _size = 0; // Already counted by the original
+    
+    original->_numShares++;
+}
+
+// Reads back what the driver compressed, to be written by the loaders
+void DGTexture::_storeInCache() {
+    TEXEntry entry;
+    GLint compressed = GL_FALSE;
+    GLint format, size;
+    GLubyte* data;
+    
+    if (!_isCubeMap && (_numLevels == 1))
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    
+    if (compressed == GL_TRUE) {
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        
+        memset(&entry, 0, sizeof(entry));
+        entry.width = _width;
+        entry.height = _height;
+        entry.depth = _depth;
+        entry.format = format;
+        entry.numLevels = 1;
+        entry.size = size;
+        entry.levelSize[0] = size;
+        
+        data = (GLubyte*)malloc(size * sizeof(GLubyte));
+        glGetCompressedTexImage(GL_TEXTURE_2D, 0, data);
+        
+        DGTextureManager::getInstance().cacheImage(_cacheFile, &entry, data);
+    }
+    
+    _cacheFile[0] = '\0';
+}
+
+void DGTexture::_uploadImage(GLenum target, int firstLevel) {
+    GLubyte* data = _bitmap;
+    
+    // Levels are stored one after the other
+    for (int level = 0; level < _numLevels; level++) {
+        GLint width = std::max(_width >> level, 1);
+        GLint height = std::max(_height >> level, 1);
+        
+        // Skipped levels only move the data forward
+        if (level < firstLevel) {
+            if (data)
+                data += _levelSize[level];
+            
+            continue;
+        }
+        
+        if (_isPrecompressed) {
+            glCompressedTexImage2D(target, level - firstLevel, _internalFormat, width, height,
+                                   0, _levelSize[level], data);
+            _size += _levelSize[level];
+        }
+        else {
+            glTexImage2D(target, level - firstLevel, _internalFormat, width, height,
+                         0, _format, GL_UNSIGNED_BYTE, data);
+            
+            _size += _storedSize(target, level - firstLevel, width, height);
+        }
+        
+        if (data)
+            data += _levelSize[level];
     }
 }
@@ -19,28 +19,23 @@
 
 #include <GL/glew.h>
 #include "DGPlatform.h"
+#include "DGTextureFormat.h"
 
 ////////////////////////////////////////////////////////////
 // Definitions
 ////////////////////////////////////////////////////////////
 
-// TODO: We should convert all short vars to int, also read all the new defines
+#define DGNumberOfFaces 6
 
-typedef struct {
-	//char	name[DGMaxFileLength];
-    char	name[80];
-	short	width;
-	short	height;
-	short	compressionLevel; // 0: None, 1: GL only, 2: GL & zlib
-	short	numTextures;
-} TEXMainHeader;
-
-typedef struct {
-	short	cubePosition;
-	short	depth;
-	int		size;
-	int		format;
-} TEXSubHeader;
+// Textures requested through the manager are decoded by the loaders
+// and then uploaded by the main thread. These are the steps in between.
+enum DGTextureStates {
+    DGTextureIdle = 0,
+    DGTextureQueued,
+    DGTextureDecoding,
+    DGTextureDecoded,
+    DGTextureUploading // Streamed over a few frames
+};
 
 class DGConfig;
 class DGLog;
@@ -53,15 +48,66 @@ class DGTexture : public DGObject {
     DGConfig* config;
     DGLog* log;
     
+    // The manager keeps the active textures in a list linked through
+    // these, from the least to the most recently requested one
+    friend class DGTextureManager;
+    bool _isActive;
+    DGTexture* _nextActive;
+    DGTexture* _previousActive;
+    
     GLubyte* _bitmap;
+    GLint _bitmapSize;
+    char _cacheFile[DGMaxPathLength + DGMaxFileLength]; // Set until compressed by the driver
+    GLubyte* _cubeFaces[DGNumberOfFaces]; // Decoded faces waiting for the upload
     unsigned int _compressionLevel;
+    int _distance; // Rooms away from the current one, evicted from the farthest
+    int _firstLevel; // Faces skip the levels bigger than the screen needs
+    GLint _format;
+    uint64_t _hash; // Of the decoded contents, zero until decoded
 	GLuint _ident;
+    GLint _internalFormat;
 	GLint _width;
 	GLint _height;
 	GLint _depth;
+    bool _hasPreview;
     bool _hasResource;
     int _indexInBundle;
+    bool _isCubeMap;
+    bool _isFace; // Covers a whole face of the node
+    bool _isFaceMapped[DGNumberOfFaces];
 	bool _isLoaded;
+    bool _isMapped; // Bitmap points to a mapped bundle, never free it
+    bool _isPrecompressed;
+    GLint _levelSize[TEXMaxLevels];
+    int _nextFace; // Where the upload goes on from
+    int _nextLevel;
+    int _nextRow;
+    int _numLevels;
+    int _numShares; // Textures using the same GL texture, never evicted while any
+    DGTexture* _original; // Whose GL texture is used instead of uploading the same
+    GLuint _previewIdent; // Drawn until the texture is loaded
+    float _priority; // Queued textures are loaded from the lowest
+    int _resolution; // Of the face on screen when queued, zero to load all levels
+    long _size; // Bytes taken in video memory
+    int _state;
+    int _uploadClass; // While waiting for the upload, see DGUploadClasses
+    
+    uint32_t _alignedOffset(uint32_t offset);
+    void _complete(GLenum target);
+    bool _decodeImage();
+    void _hashContents();
+    void _keepAsPreview();
+    int _levelFor(int resolution);
+    bool _mapBundle(bool canUnpack = true);
+    bool _readBundle(FILE* fh);
+    bool _readCache();
+    void _releaseBitmap();
+    void _releaseFaces();
+    void _releasePreview();
+    void _share(DGTexture* original);
+    GLint _storedSize(GLenum target, int level, GLint width, GLint height);
+    void _storeInCache();
+    void _uploadImage(GLenum target, int firstLevel = 0);
     
     // This is used to keep trace of the most used textures
     unsigned int _usageCount;
@@ -76,8 +122,11 @@ public:
     
     // Checks
 
+    bool hasPreview();
     bool hasResource();
+    bool isCubeMap();
     bool isLoaded();
+    bool isPending();
     
     // Gets
     
@@ -85,21 +134,43 @@ public:
     int indexInBundle();
     int height();
     const char* resource();
+    
+    // Bytes taken by the texture once uploaded, or an estimate
+    // of the worst case while it isn't
+    long size();
+    int state();
     unsigned int usageCount();
     int width();
     
     // Sets
     
     void increaseUsageCount();
+    
+    // Cube maps take all the faces from the bundle, starting from the first one
+    void setCubeMap(bool enabled);
     void setIndexInBundle(int index);
     void setResource(const char* fromFileName);
+    void setState(int theState);
     
     // State changes
     
     void bind();
     void clear();
+    
+    // Decoding doesn't require a GL context and can be performed by
+    // any thread, but the upload must happen in the main one
+    bool decode();
     void load();
     
+    // Uploads right away the small levels of a bundle, if it has them,
+    // so that something is drawn while the texture is loaded
+    void loadPreview();
+    
+    // Uploads the next part of the decoded data, as much as the manager
+    // allows this frame. Returns true once the texture is loaded.
+    bool stream();
+    void upload();
+    
     // Textures loaded from memory are not managed
     void loadFromMemory(const unsigned char* dataToLoad, long size);
     void loadRawData(const unsigned char* dataToLoad, int width, int height);
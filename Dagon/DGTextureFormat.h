@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////
+//
+// DAGON - An Adventure Game Engine
+// Copyright (c) 2011 Senscape s.r.l.
+// All rights reserved.
+//
+// NOTICE: Senscape permits you to use, modify, and
+// distribute this file in accordance with the terms of the
+// license agreement accompanying it.
+//
+////////////////////////////////////////////////////////////
+
+#ifndef DG_TEXTUREFORMAT_H
+#define DG_TEXTUREFORMAT_H
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+
+// Shared with the offline baker, so nothing here may require GL or the
+// platform headers
+
+#include <stdint.h>
+#include <string.h>
+
+////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////
+
+// NOTE: These are the original bundles, still supported for reading
+
+typedef struct {
+	//char	name[DGMaxFileLength];
+    char	name[80];
+	short	width;
+	short	height;
+	short	compressionLevel; // 0: None, 1: GL only
+	short	numTextures;
+} TEXMainHeader;
+
+typedef struct {
+	short	cubePosition;
+	short	depth;
+	int		size;
+	int		format;
+} TEXSubHeader;
+
+// Version 2 bundles begin with their own identifier and the main header, followed
+// by a directory with one entry per texture so that any of them is reached with a
+// single seek. Payloads are aligned and the mipmap levels of each texture are
+// stored one after the other, starting with the largest.
+//
+// Faces may also be split in tiles, in which case the bundle holds a pyramid of
+// them for every face, from the full size down to a single tile. The position of
+// each tile is then packed with TEXTilePosition.
+
+#define TEXIdentV2      "DG_TEX"
+#define TEXVersion      2
+#define TEXAlignment    4096
+#define TEXMaxLevels    16
+
+#define TEXTilePosition(face, level, x, y) ((face) | ((level) << 4) | ((x) << 8) | ((y) << 20))
+#define TEXTileFace(position)   ((position) & 0xf)
+#define TEXTileLevel(position)  (((position) >> 4) & 0xf)
+#define TEXTileX(position)      (((position) >> 8) & 0xfff)
+#define TEXTileY(position)      ((position) >> 20)
+
+// With compression level 2 the payload of every entry is packed, in
+// chunks that are unpacked in parallel. The payload then begins with the number
+// of chunks and a table describing them, followed by their data. The size of
+// the entry is that of the packed payload, while its levels keep their sizes.
+
+#define TEXChunkSize    (256 * 1024) // Unpacked, except the last one
+
+enum TEXCodecs {
+    TEXCodecStored = 0, // When packing doesn't pay off
+    TEXCodecZlib,
+    TEXCodecLZ4
+};
+
+typedef struct {
+    uint32_t    codec;
+    uint32_t    size; // Unpacked
+    uint32_t    packedSize;
+    uint32_t    checksum; // See TEXChecksum
+} TEXChunk;
+
+// Adler-32 of the unpacked data, the same as zlib
+static inline uint32_t TEXChecksum(const unsigned char* data, uint32_t size) {
+    uint32_t a = 1, b = 0;
+    
+    while (size) {
+        // The largest run before the sums may overflow
+        uint32_t run = (size < 5552) ? size : 5552;
+        
+        size -= run;
+        
+        while (run--) {
+            a += *data++;
+            b += a;
+        }
+        
+        a %= 65521;
+        b %= 65521;
+    }
+    
+    return (b << 16) | a;
+}
+
+// 64-bit FNV-1a taken a word at a time, which tells identical textures
+// apart from the rest without comparing them byte by byte
+static inline uint64_t TEXHash(const unsigned char* data, long size, uint64_t hash) {
+    uint64_t word;
+    
+    while (size >= (long)sizeof(word)) {
+        memcpy(&word, data, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+        hash ^= hash >> 29; // Otherwise high bits never reach the low ones
+        data += sizeof(word);
+        size -= sizeof(word);
+    }
+    
+    while (size--)
+        hash = (hash ^ *data++) * 1099511628211ULL;
+    
+    return hash;
+}
+
+typedef struct {
+    char        name[80];
+    uint32_t    version;
+    uint32_t    numTextures;
+    uint32_t    compressionLevel; // 0: None, 1: GL, 2: Packed too, see TEXIsCompressed
+    uint32_t    tileSize; // Zero unless the faces are split in tiles
+} TEXMainHeaderV2;
+
+typedef struct {
+    uint32_t    cubePosition;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    depth; // Number of channels
+    uint32_t    format; // Internal GL format
+    uint32_t    numLevels;
+    uint32_t    offset; // From the beginning of the file
+    uint32_t    size; // Of all levels
+    uint32_t    levelSize[TEXMaxLevels];
+} TEXEntry;
+
+// Internal formats of the entries, with the values GL gives them
+
+#define TEXFormatDXT1   0x83F0 // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define TEXFormatDXT5   0x83F3 // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define TEXFormatRGBA   0x1908 // GL_RGBA
+
+// Whether the entries of a bundle with the given compression level and
+// format are compressed for the driver. Bundles may hold plain entries
+// next to compressed ones, such as atlas pages, so the format decides.
+static inline bool TEXIsCompressed(uint32_t compressionLevel, uint32_t format) {
+    if (!compressionLevel)
+        return false;
+    
+    switch (format) {
+        case 0x1907: // GL_RGB
+        case 0x1908: // GL_RGBA
+        case 0x1909: // GL_LUMINANCE
+        case 0x190A: // GL_LUMINANCE_ALPHA
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Small interface images are packed into pages, leaving a border around
+// each one that repeats its edges so that filtering doesn't bleed
+#define DGAtlasBorder       1
+#define DGAtlasIndex        "atlas.idx" // Written by the baker
+#define DGAtlasMaxImage     256
+#define DGAtlasSize         1024
+
+#endif // DG_TEXTUREFORMAT_H
@@ -14,11 +14,28 @@
 // Headers
 ////////////////////////////////////////////////////////////
 
+#include "DGCameraManager.h"
 #include "DGConfig.h"
 #include "DGLog.h"
 #include "DGNode.h"
 #include "DGSpot.h"
+#include "DGSystem.h"
 #include "DGTextureManager.h"
+#include "stb_image.h"
+
+#include <sys/stat.h>
+
+#ifdef DGPlatformWindows
+// Windows.h is already included by the platform header
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
 
 using namespace std;
 
@@ -26,8 +43,6 @@ using namespace std;
 // Definitions
 ////////////////////////////////////////////////////////////
 
-bool DGTextureSort(DGTexture* t1, DGTexture* t2);
-
 ////////////////////////////////////////////////////////////
 // Implementation - Constructor
 ////////////////////////////////////////////////////////////
@@ -35,6 +50,37 @@ bool DGTextureSort(DGTexture* t1, DGTexture* t2);
 DGTextureManager::DGTextureManager() {
     log = &DGLog::getInstance();
     config = &DGConfig::getInstance();
+    
+    _leastRecentTexture = NULL;
+    _mostRecentTexture = NULL;
+    
+    // Nowhere in particular
+    _focus.x = 0.0;
+    _focus.y = 0.0;
+    _focus.z = 0.0;
+    _faceResolution = 0;
+    _numPendingFiles = 0;
+    _numPreloadedFiles = 0;
+    
+    _hasAtlasIndex = false;
+    
+    _cacheSize = 0;
+    _chargedBytes = 0;
+    _currentUploadBuffer = 0;
+    _hasUploadBuffers = false;
+    _hasUploaded = false;
+    _isStaging = false;
+    _uploadBytes = 0;
+    _uploadStart = 0;
+    
+    _deferredBytes = 0;
+    _evictions = 0;
+    _hits = 0;
+    _misses = 0;
+    _sharedImageBytes = 0;
+    _uploadedBytes = 0;
+    
+    _isRunning = false;
 }
 
 ////////////////////////////////////////////////////////////
@@ -42,6 +88,27 @@ DGTextureManager::DGTextureManager() {
 ////////////////////////////////////////////////////////////
 
 DGTextureManager::~DGTextureManager() {
+    DGTexture* texture;
+    
+    // Textures sharing another one go first, as they point to it
+    for (texture = _leastRecentTexture; texture; texture = texture->_nextActive) {
+        if (texture->_original)
+            texture->unload();
+    }
+    
+    if (!_arrayOfPrefetchedTextures.empty()) {
+        vector<DGTexture*>::iterator it;
+        
+        it = _arrayOfPrefetchedTextures.begin();
+        
+        while (it != _arrayOfPrefetchedTextures.end()) {
+            if ((*it)->_original)
+                (*it)->unload();
+            
+            it++;
+        }
+    }
+    
     if (!_arrayOfTextures.empty()) {
         vector<DGTexture*>::iterator it;
         
@@ -52,20 +119,228 @@ DGTextureManager::~DGTextureManager() {
             it++;
         }   
     }
+    
+    if (!_arrayOfTileSets.empty()) {
+        vector<DGTileSet*>::iterator it;
+        
+        it = _arrayOfTileSets.begin();
+        
+        while (it != _arrayOfTileSets.end()) {
+            delete *it;
+            it++;
+        }
+    }
+    
+    // Textures are gone, so it's safe to release the mappings
+    if (!_mapOfBundles.empty()) {
+        map<string, DGMappedBundle>::iterator it;
+        
+        it = _mapOfBundles.begin();
+        
+        while (it != _mapOfBundles.end()) {
+            _unmapFile((*it).second.data, (*it).second.size);
+            it++;
+        }
+    }
+    
+    if (_hasUploadBuffers) {
+        for (int i = 0; i < DGUploadBuffers; i++) {
+            if (_arrayOfUploadBuffers[i].fence)
+                glDeleteSync(_arrayOfUploadBuffers[i].fence);
+            
+            glDeleteBuffers(1, &_arrayOfUploadBuffers[i].ident);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Profiling
+////////////////////////////////////////////////////////////
+
+unsigned long DGTextureManager::deferredBytes() {
+    return _deferredBytes;
+}
+
+unsigned long DGTextureManager::evictions() {
+    return _evictions;
+}
+
+unsigned long DGTextureManager::hits() {
+    return _hits;
+}
+
+unsigned long DGTextureManager::misses() {
+    return _misses;
+}
+
+// Only counts the textures in use
+unsigned long DGTextureManager::sharedBytes() {
+    unsigned long bytes = _sharedImageBytes;
+    DGTexture* texture;
+    
+    for (texture = _leastRecentTexture; texture; texture = texture->_nextActive) {
+        if (texture->_original)
+            bytes += texture->_original->size();
+    }
+    
+    return bytes;
+}
+
+unsigned long DGTextureManager::uploadedBytes() {
+    return _uploadedBytes;
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Streaming uploads
+////////////////////////////////////////////////////////////
+
+bool DGTextureManager::beginUpload(const GLubyte* data, long size, const GLvoid** pixels) {
+    if (_hasUploaded && !_isWithinBudget(size))
+        return false;
+    
+    _uploadBytes -= size;
+    _uploadedBytes += size;
+    _hasUploaded = true;
+    
+    *pixels = data;
+    
+    if (_hasUploadBuffers && (size <= DGUploadBufferSize)) {
+        DGUploadBuffer* buffer = &_arrayOfUploadBuffers[_currentUploadBuffer];
+        GLvoid* mapped;
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->ident);
+        
+        // If GL is done with the previous upload the buffer is written in place.
+        // Otherwise it's orphaned, so that the driver hands over new storage
+        // instead of waiting.
+        if (buffer->fence) {
+            if (glClientWaitSync(buffer->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, DGUploadBufferSize, NULL, GL_STREAM_DRAW);
+            
+            glDeleteSync(buffer->fence);
+            buffer->fence = NULL;
+        }
+        
+        mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT |
+                                  GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        
+        if (mapped) {
+            memcpy(mapped, data, size);
+            
+            if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+                // From now on an offset in the buffer
+                *pixels = NULL;
+                _isStaging = true;
+                
+                return true;
+            }
+        }
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    
+    return true;
+}
+
+void DGTextureManager::chargeUpload(long size) {
+    _chargedBytes += size;
+}
+
+void DGTextureManager::endUpload() {
+    if (_isStaging) {
+        DGUploadBuffer* buffer = &_arrayOfUploadBuffers[_currentUploadBuffer];
+        
+        buffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        
+        _currentUploadBuffer = (_currentUploadBuffer + 1) % DGUploadBuffers;
+        _isStaging = false;
+    }
+}
+
+long DGTextureManager::uploadBytes() {
+    long bytes = DGUploadBufferSize;
+    
+    if (config->uploadBudget)
+        bytes = min(bytes, _uploadBytes);
+    
+    return max(bytes, 0L);
 }
 
 ////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////
 
+void DGTextureManager::appendBaseTiles(DGTileSet* tileSet, vector<DGTexture*> &arrayOfTextures) {
+    vector<DGTile>::iterator it;
+    
+    if (!tileSet->isLoaded && !_loadTiles(tileSet))
+        return;
+    
+    it = tileSet->arrayOfTiles.begin();
+    
+    while (it != tileSet->arrayOfTiles.end()) {
+        if ((*it).level != (tileSet->numLevels - 1))
+            break;
+        
+        arrayOfTextures.push_back((*it).texture);
+        it++;
+    }
+}
+
 void DGTextureManager::appendTextureToBundle(const char* nameOfBundle, DGTexture* textureToAppend) {
     // This function will store individual textures to a bundle
 }
 
+void DGTextureManager::cacheImage(const char* cacheFile, TEXEntry* entry, GLubyte* data) {
+    DGCachedImage cachedImage;
+    
+    cachedImage.fileName = cacheFile;
+    cachedImage.entry = *entry;
+    cachedImage.data = data;
+    
+    system->suspendThread(DGTextureThread);
+    _arrayOfCachedImages.push_back(cachedImage);
+    system->signalThread(DGTextureThread);
+    system->resumeThread(DGTextureThread);
+}
+
 void DGTextureManager::createBundle(const char* nameOfBundle) {
     // This function will create bundles to store textures
 }
 
+bool DGTextureManager::findCachedImage(const char* fileName, char* cacheFile) {
+    struct stat source, cached;
+    char key[DGMaxPathLength + DGMaxFileLength + 256];
+    uint32_t hash[2] = {2166136261u, 16777619u};
+    
+    cacheFile[0] = '\0';
+    
+    if (_cachePath.empty() || (stat(fileName, &source) != 0))
+        return false;
+    
+    // Any change to the file or the driver gives another name
+    snprintf(key, sizeof(key), "%s|%ld|%ld|%s", fileName, (long)source.st_mtime,
+             (long)source.st_size, _driverIdent.c_str());
+    
+    // Two rounds of FNV-1a with different seeds, so that names don't collide
+    for (int i = 0; key[i]; i++) {
+        hash[0] = (hash[0] ^ (unsigned char)key[i]) * 16777619u;
+        hash[1] = (hash[1] ^ (unsigned char)key[i]) * 2166136261u;
+    }
+    
+    snprintf(cacheFile, DGMaxPathLength + DGMaxFileLength, "%s%08x%08x.%s", _cachePath.c_str(),
+             hash[0], hash[1], DGDefTexExtension);
+    
+    if (stat(cacheFile, &cached) != 0)
+        return false;
+    
+    // Pruned last, as the least recently used files go first
+    utime(cacheFile, NULL);
+    
+    return true;
+}
+
 int DGTextureManager::itemsInBundle(const char* nameOfBundle) {
     // This one should return the number of textures in a bundle
     return 0;
@@ -75,14 +350,282 @@ void DGTextureManager::flush() {
     // This function is called every time a switch is performed
     // and unloads the least used textures if necessary
     
-    long texturesToUnload = _arrayOfActiveTextures.size() - DGMaxActiveTextures;
+    vector<DGTexture*> arrayOfTiles;
+    
+    // The textures of the new node replace those of the previous one,
+    // including its tiles, which are requested again if it has them
+    _arrayOfPinnedTextures.swap(_arrayOfRequestedTextures);
+    _arrayOfRequestedTextures.clear();
+    _updateVisibleTiles(arrayOfTiles);
+    
+    _evict();
+}
+
+void DGTextureManager::init() {
+    cameraManager = &DGCameraManager::getInstance();
+    system = &DGSystem::getInstance();
+    
+    // Cached images are only valid for the driver that compressed them
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    
+    _driverIdent = string(vendor ? vendor : "") + "/" + (renderer ? renderer : "") + "/" + (version ? version : "");
+    
+    if (config->cacheBudget) {
+        _cachePath = config->path(DGPathUser, DGDefCachePath);
+        
+#ifdef DGPlatformWindows
+        _mkdir(_cachePath.c_str());
+#else
+        mkdir(_cachePath.c_str(), 0755);
+#endif
+        
+        // The loaders don't exist yet, so no need to lock
+        _cacheSize = _pruneCache();
+    }
+    
+    // Orphaning needs buffers mapped by range, and fences tell when to do it
+    _hasUploadBuffers = GLEW_ARB_pixel_buffer_object && GLEW_ARB_map_buffer_range && GLEW_ARB_sync;
+    
+    if (_hasUploadBuffers) {
+        for (int i = 0; i < DGUploadBuffers; i++) {
+            glGenBuffers(1, &_arrayOfUploadBuffers[i].ident);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _arrayOfUploadBuffers[i].ident);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, DGUploadBufferSize, NULL, GL_STREAM_DRAW);
+            _arrayOfUploadBuffers[i].fence = NULL;
+        }
+        
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    
+    _isRunning = true;
+}
+
+GLubyte* DGTextureManager::mapBundle(const char* fileName, long* size) {
+    map<string, DGMappedBundle>::iterator it;
+    GLubyte* data = NULL;
+    
+    // Loaders may map bundles concurrently
+    system->suspendThread(DGTextureThread);
+    
+    it = _mapOfBundles.find(fileName);
+    
+    if (it != _mapOfBundles.end()) {
+        data = (*it).second.data;
+        *size = (*it).second.size;
+    }
+    else {
+        DGMappedBundle bundle;
+        
+        bundle.data = _mapFile(fileName, &bundle.size);
+        
+        if (bundle.data) {
+            TEXMainHeaderV2 header;
+            
+            // Images and older bundles are read as usual, so we keep
+            // only the mappings that are worth it
+            if ((bundle.size >= (long)(8 + sizeof(header))) &&
+                (memcmp(TEXIdentV2, bundle.data, 7) == 0)) {
+                memcpy(&header, bundle.data + 8, sizeof(header));
+                
+                if (header.version == TEXVersion) {
+                    _mapOfBundles[fileName] = bundle;
+                    
+                    data = bundle.data;
+                    *size = bundle.size;
+                }
+            }
+            
+            if (!data)
+                _unmapFile(bundle.data, bundle.size);
+        }
+    }
+    
+    system->resumeThread(DGTextureThread);
+    
+    return data;
+}
+
+void DGTextureManager::prefetch(vector<DGTexture*> &arrayOfTextures, vector<string> &arrayOfFiles) {
+    vector<DGTexture*> arrayOfPrefetchedTextures;
+    vector<DGTexture*>::iterator it;
+    long budget = (long)config->prefetchBudget * 1024 * 1024;
+    long usedBytes = 0;
+    
+    system->suspendThread(DGTextureThread);
+    
+    // Cancel the prefetches that didn't start yet
+    it = _arrayOfQueuedPrefetches.begin();
+    
+    while (it != _arrayOfQueuedPrefetches.end()) {
+        (*it)->setState(DGTextureIdle);
+        it++;
+    }
+    
+    _arrayOfQueuedPrefetches.clear();
+    
+    // Nearest textures come first, so we stop as soon as the budget is exceeded
+    it = arrayOfTextures.begin();
+    
+    while (it != arrayOfTextures.end()) {
+        DGTexture* texture = *it;
+        
+        it++;
+        
+        // Skip repeated and already requested textures
+        if (find(arrayOfPrefetchedTextures.begin(), arrayOfPrefetchedTextures.end(),
+                 texture) != arrayOfPrefetchedTextures.end())
+            continue;
+        
+        if (texture->_isActive)
+            continue;
+        
+        usedBytes += texture->size();
+        
+        if (usedBytes > budget)
+            break;
+        
+        if (!texture->isLoaded() && !texture->isPending()) {
+            texture->_resolution = texture->_isFace ? cameraManager->faceResolution() : 0;
+            texture->setState(DGTextureQueued);
+            _arrayOfQueuedPrefetches.push_back(texture);
+        }
+        
+        arrayOfPrefetchedTextures.push_back(texture);
+    }
+    
+    // Now release the stale textures, that is, those from the previous
+    // prefetch that aren't near the player anymore
+    it = _arrayOfPrefetchedTextures.begin();
+    
+    while (it != _arrayOfPrefetchedTextures.end()) {
+        DGTexture* texture = *it;
+        
+        if (find(arrayOfPrefetchedTextures.begin(), arrayOfPrefetchedTextures.end(),
+                 texture) == arrayOfPrefetchedTextures.end()) {
+            switch (texture->state()) {
+                case DGTextureDecoding:
+                    // A loader owns this one, release it next time
+                    arrayOfPrefetchedTextures.push_back(texture);
+                    break;
+                case DGTextureDecoded:
+                    _arrayOfDecodedTextures.erase(find(_arrayOfDecodedTextures.begin(),
+                                                       _arrayOfDecodedTextures.end(), texture));
+                    texture->setState(DGTextureIdle);
+                    texture->unload();
+                    break;
+                case DGTextureUploading:
+                    _arrayOfUploadingTextures.erase(find(_arrayOfUploadingTextures.begin(),
+                                                         _arrayOfUploadingTextures.end(), texture));
+                    texture->setState(DGTextureIdle);
+                    texture->unload();
+                    break;
+                default:
+                    // Others may still draw with it
+                    if (!texture->_numShares)
+                        texture->unload();
+                    break;
+            }
+        }
+        
+        it++;
+    }
+    
+    _arrayOfPrefetchedTextures.swap(arrayOfPrefetchedTextures);
+    _arrayOfQueuedFiles = arrayOfFiles;
+    
+    system->signalThread(DGTextureThread);
+    system->resumeThread(DGTextureThread);
+}
+
+void DGTextureManager::preload(vector<DGTexture*> &arrayOfTextures, vector<string> &arrayOfFiles) {
+    vector<DGTexture*>::iterator it;
+    
+    system->suspendThread(DGTextureThread);
+    
+    // Cancel the preloads that didn't start yet
+    it = _arrayOfQueuedPreloads.begin();
+    
+    while (it != _arrayOfQueuedPreloads.end()) {
+        (*it)->setState(DGTextureIdle);
+        it++;
+    }
+    
+    _arrayOfQueuedPreloads.clear();
+    _arrayOfPreloadedTextures.clear();
+    
+    it = arrayOfTextures.begin();
+    
+    while (it != arrayOfTextures.end()) {
+        DGTexture* texture = *it;
+        vector<DGTexture*>::iterator prefetched;
+        
+        it++;
+        
+        if (find(_arrayOfPreloadedTextures.begin(), _arrayOfPreloadedTextures.end(),
+                 texture) != _arrayOfPreloadedTextures.end())
+            continue;
+        
+        // Prefetched textures are taken over, so they aren't released as stale
+        prefetched = find(_arrayOfPrefetchedTextures.begin(), _arrayOfPrefetchedTextures.end(), texture);
+        
+        if (prefetched != _arrayOfPrefetchedTextures.end())
+            _arrayOfPrefetchedTextures.erase(prefetched);
+        
+        prefetched = find(_arrayOfQueuedPrefetches.begin(), _arrayOfQueuedPrefetches.end(), texture);
+        
+        if (prefetched != _arrayOfQueuedPrefetches.end()) {
+            _arrayOfQueuedPrefetches.erase(prefetched);
+            _arrayOfQueuedPreloads.push_back(texture);
+        }
+        else if (!texture->isLoaded() && !texture->isPending()) {
+            texture->_priority = DGPreloadPriority;
+            texture->_resolution = texture->_isFace ? cameraManager->faceResolution() : 0;
+            texture->setState(DGTextureQueued);
+            _arrayOfQueuedPreloads.push_back(texture);
+        }
+        
+        // Active textures count against the budget, and pinned ones stay
+        if (!texture->_isActive)
+            _link(texture);
+        
+        _arrayOfPinnedTextures.push_back(texture);
+        _arrayOfPreloadedTextures.push_back(texture);
+    }
+    
+    _arrayOfPreloadedFiles = arrayOfFiles;
+    _numPendingFiles = (int)arrayOfFiles.size();
+    _numPreloadedFiles = _numPendingFiles;
+    
+    system->signalThread(DGTextureThread);
+    system->resumeThread(DGTextureThread);
+}
 
-    while (texturesToUnload > 0) {
-        _arrayOfActiveTextures.front()->unload();
-        _arrayOfActiveTextures.erase(_arrayOfActiveTextures.begin());
+float DGTextureManager::preloadProgress() {
+    vector<DGTexture*>::iterator it;
+    int total = (int)_arrayOfPreloadedTextures.size() + _numPreloadedFiles;
+    int done;
+    
+    if (!total)
+        return 1.0f;
+    
+    system->suspendThread(DGTextureThread);
+    
+    done = _numPreloadedFiles - _numPendingFiles;
+    it = _arrayOfPreloadedTextures.begin();
+    
+    while (it != _arrayOfPreloadedTextures.end()) {
+        // Either uploaded, shared or given up
+        if ((*it)->state() == DGTextureIdle)
+            done++;
         
-        texturesToUnload--;
+        it++;
     }
+    
+    system->resumeThread(DGTextureThread);
+    
+    return (float)done / (float)total;
 }
 
 void DGTextureManager::registerTexture(DGTexture* target) {
@@ -117,7 +660,54 @@ void DGTextureManager::registerTexture(DGTexture* target) {
 }
 
 void DGTextureManager::requestBundle(DGNode* forNode) {
-    if (forNode->hasBundleName()) {
+    // Bundles with tiles are recognized by their header, and the rest
+    // of it is read on the first visit
+    if (forNode->hasBundleName() && config->bundleEnabled) {
+        TEXMainHeaderV2 header;
+        char ident[8];
+        char fileName[DGMaxFileLength];
+        FILE* fh;
+        
+        snprintf(fileName, DGMaxFileLength, "%s.%s", forNode->bundleName(), config->texExtension());
+        fh = fopen(config->path(DGPathRes, fileName, DGObjectNode), "rb");
+        
+        if (fh) {
+            bool hasTiles = (fread(ident, 1, sizeof(ident), fh) == sizeof(ident)) &&
+                            (memcmp(TEXIdentV2, ident, 7) == 0) &&
+                            (fread(&header, 1, sizeof(header), fh) == sizeof(header)) &&
+                            (header.version == TEXVersion) && header.tileSize;
+            
+            fclose(fh);
+            
+            if (hasTiles) {
+                DGTileSet* tileSet = new DGTileSet;
+                
+                tileSet->fileName = config->path(DGPathRes, fileName, DGObjectNode);
+                tileSet->isLoaded = false;
+                tileSet->faceSize = 0;
+                tileSet->numLevels = 0;
+                
+                _arrayOfTileSets.push_back(tileSet);
+                forNode->setTileSet(tileSet);
+                
+                return;
+            }
+        }
+    }
+    
+    // Cube maps need all the faces in a single file
+    if (forNode->hasBundleName() && config->cubeMaps && config->bundleEnabled) {
+        DGTexture* texture = new DGTexture;
+        
+        texture->setCubeMap(true);
+        texture->setName(forNode->bundleName());
+        texture->_isFace = true;
+        
+        registerTexture(texture);
+        
+        forNode->setCubeMap(texture);
+    }
+    else if (forNode->hasBundleName()) {
         for (int i = 0; i < 6; i++) {
             std::vector<int> arrayOfCoordinates;
             // We ensure the texture is properly stretched, so we take the default cube size
@@ -131,6 +721,7 @@ void DGTextureManager::requestBundle(DGNode* forNode) {
             
             spot->setTexture(texture);
             spot->texture()->setIndexInBundle(i);
+            texture->_isFace = true;
             
             // In this case, the filename is generated from the name
             // of the texture
@@ -145,22 +736,1372 @@ void DGTextureManager::requestBundle(DGNode* forNode) {
     // Possibly raise an error if this fails
 }
 
-void DGTextureManager::requestTexture(DGTexture* target) {
-    if (!target->isLoaded()) {
-        target->load();
+DGTexture* DGTextureManager::requestImage(const char* fileName, float* arrayOfTexCoords, DGSize* size) {
+    vector<DGAtlasImage>::iterator it;
+    DGAtlasImage image;
+    DGTexture* texture;
+    
+    if (!_hasAtlasIndex)
+        _loadAtlasIndex();
+    
+    // Images are shared, and those baked offline are found here too
+    const char* baseName = strrchr(fileName, '/');
+    baseName = baseName ? (baseName + 1) : fileName;
+    
+    it = _arrayOfAtlasImages.begin();
+    
+    while (it != _arrayOfAtlasImages.end()) {
+        if (((*it).fileName == fileName) || ((*it).fileName == baseName)) {
+            memcpy(arrayOfTexCoords, (*it).arrayOfTexCoords, sizeof((*it).arrayOfTexCoords));
+            *size = (*it).size;
+            
+            return (*it).texture;
+        }
         
-        _arrayOfActiveTextures.push_back(target);
+        it++;
     }
     
-    target->increaseUsageCount();
+    texture = new DGTexture;
+    texture->setResource(fileName);
+    
+    image.fileName = fileName;
+    image.texture = texture;
+    image.size.width = 0;
+    image.size.height = 0;
+    image.hash = 0;
+    
+    if (texture->decode()) {
+        image.hash = texture->_hash;
+        image.size.width = texture->width();
+        image.size.height = texture->height();
+        
+        // The same image under another name takes the same place
+        it = _arrayOfAtlasImages.begin();
+        
+        while (it != _arrayOfAtlasImages.end()) {
+            if (image.hash && ((*it).hash == image.hash)) {
+                image.texture = (*it).texture;
+                memcpy(image.arrayOfTexCoords, (*it).arrayOfTexCoords, sizeof(image.arrayOfTexCoords));
+                _sharedImageBytes += texture->size();
+                
+                break;
+            }
+            
+            it++;
+        }
+        
+        if (image.texture != texture)
+            delete texture;
+        // Compressed images can't be copied into a page
+        else if (!texture->_isPrecompressed && !texture->_isCubeMap &&
+                 (texture->width() <= DGAtlasMaxImage) && (texture->height() <= DGAtlasMaxImage) &&
+                 _pack(texture, &image)) {
+            delete texture;
+        }
+        else {
+            // Drawn once uploaded, within the budget of the frame
+            texture->setState(DGTextureUploading);
+            _queueUpload(texture, DGUploadInterface);
+        }
+    }
+    
+    if (image.texture == texture) {
+        GLfloat texCoords[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+        memcpy(image.arrayOfTexCoords, texCoords, sizeof(texCoords));
+        
+        _arrayOfTextures.push_back(texture);
+    }
+    
+    _arrayOfAtlasImages.push_back(image);
+    
+    memcpy(arrayOfTexCoords, image.arrayOfTexCoords, sizeof(image.arrayOfTexCoords));
+    *size = image.size;
     
-    sort(_arrayOfActiveTextures.begin(), _arrayOfActiveTextures.end(), DGTextureSort);
+    return image.texture;
 }
 
-////////////////////////////////////////////////////////////
-// Implementation - Private methods
-////////////////////////////////////////////////////////////
+void DGTextureManager::requestTexture(DGTexture* target) {
+    // Something to draw until the loaders get to it
+    target->loadPreview();
+    
+    if (!target->isPending())
+        target->_priority = 0.0f;
+    
+    _request(target);
+    _arrayOfRequestedTextures.push_back(target);
+}
+
+void DGTextureManager::requestTexture(DGTexture* target, DGVector direction) {
+    target->loadPreview();
+    
+    if (!target->isPending())
+        target->_priority = _priorityOf(direction);
+    
+    _request(target);
+    _arrayOfRequestedTextures.push_back(target);
+}
 
-bool DGTextureSort(DGTexture* t1, DGTexture* t2) {
-    return t1->usageCount() < t2->usageCount();
+void DGTextureManager::requestTiles(DGTileSet* tileSet, vector<DGTile*> &arrayOfTiles) {
+    vector<DGTexture*> arrayOfVisibleTiles;
+    vector<DGTile>::iterator it;
+    int faceResolution = cameraManager->faceResolution();
+    int level = 0;
+    bool hasRequested = false;
+    
+    arrayOfTiles.clear();
+    
+    if (!tileSet->isLoaded && !_loadTiles(tileSet))
+        return;
+    
+    // The smallest level that still has a texel for every pixel
+    while ((level < (tileSet->numLevels - 1)) && ((tileSet->faceSize >> (level + 1)) >= faceResolution))
+        level++;
+    
+    it = tileSet->arrayOfTiles.begin();
+    
+    while (it != tileSet->arrayOfTiles.end()) {
+        DGTile* tile = &(*it);
+        
+        it++;
+        
+        if (tile->level < level)
+            break;
+        
+        // The whole smallest level is kept, so that there's always
+        // something to draw while panning
+        bool isInView = cameraManager->isInView(tile->center, tile->radius);
+        
+        if (!isInView && (tile->level != (tileSet->numLevels - 1)))
+            continue;
+        
+        if (find(_arrayOfVisibleTiles.begin(), _arrayOfVisibleTiles.end(),
+                 tile->texture) == _arrayOfVisibleTiles.end()) {
+            // Smaller levels first, and then the tiles nearer the view
+            if (!tile->texture->isPending())
+                tile->texture->_priority = _priorityOf(tile->center) +
+                                           (float)(tileSet->numLevels - 1 - tile->level);
+            
+            _request(tile->texture);
+            hasRequested = true;
+        }
+        else {
+            if (tile->texture->_isActive)
+                _unlink(tile->texture);
+            
+            _link(tile->texture);
+        }
+        
+        arrayOfVisibleTiles.push_back(tile->texture);
+        
+        if (isInView)
+            arrayOfTiles.push_back(tile);
+    }
+    
+    _updateVisibleTiles(arrayOfVisibleTiles);
+    
+    // The new tiles take the place of those that left the view
+    if (hasRequested)
+        _evict();
+}
+
+void DGTextureManager::process() {
+    vector<DGTexture*> arrayOfTextures;
+    int faceResolution = cameraManager->faceResolution();
+    
+    // The window was resized or the camera zoomed in
+    if (faceResolution > _faceResolution)
+        _upgrade(faceResolution);
+    
+    _faceResolution = faceResolution;
+    
+    system->suspendThread(DGTextureThread);
+    arrayOfTextures.swap(_arrayOfDecodedTextures);
+    system->resumeThread(DGTextureThread);
+    
+    if (!arrayOfTextures.empty()) {
+        vector<DGTexture*>::iterator it;
+        
+        it = arrayOfTextures.begin();
+        
+        while (it != arrayOfTextures.end()) {
+            DGTexture* original = _findOriginal(*it);
+            
+            // Nothing to upload if an identical texture is already there
+            if (original) {
+                (*it)->_share(original);
+                (*it)->setState(DGTextureIdle);
+            }
+            else {
+                (*it)->setState(DGTextureUploading);
+                _queueUpload(*it, (*it)->_isActive ? DGUploadVisible : DGUploadPrefetch);
+            }
+            
+            it++;
+        }
+    }
+    
+    // Whatever went up right away since the last frame leaves less for the rest
+    _hasUploaded = false;
+    _uploadBytes = ((long)config->uploadBudget * 1024) - _chargedBytes;
+    _uploadedBytes = _chargedBytes;
+    _uploadStart = system->monotonicTime();
+    _chargedBytes = 0;
+    
+    // Big textures take a few frames, resumed where they were left
+    while (!_arrayOfUploadingTextures.empty()) {
+        DGTexture* texture = _arrayOfUploadingTextures.front();
+        
+        if (!texture->stream())
+            break;
+        
+        texture->setState(DGTextureIdle);
+        _arrayOfUploadingTextures.erase(_arrayOfUploadingTextures.begin());
+    }
+    
+    _deferredBytes = 0;
+    
+    for (unsigned int i = 0; i < _arrayOfUploadingTextures.size(); i++) {
+        DGTexture* texture = _arrayOfUploadingTextures[i];
+        
+        // The estimate of the whole texture, less what is already there
+        _deferredBytes += max(texture->size() - texture->_size, 0L);
+    }
+}
+
+void DGTextureManager::setDistance(DGNode* node, int distance) {
+    if (node->hasCubeMap())
+        node->cubeMap()->_distance = distance;
+    
+    // Every level, since tiles seen in a visit stay until evicted
+    if (node->hasTileSet()) {
+        DGTileSet* tileSet = node->tileSet();
+        
+        for (unsigned int i = 0; i < tileSet->arrayOfTiles.size(); i++)
+            tileSet->arrayOfTiles[i].texture->_distance = distance;
+    }
+    
+    if (!node->hasSpots())
+        return;
+    
+    node->beginIteratingSpots();
+    do {
+        DGSpot* spot = node->currentSpot();
+        
+        if (spot->hasTexture())
+            spot->texture()->_distance = distance;
+    } while (node->iterateSpots());
+}
+
+void DGTextureManager::setFocus(DGVector direction) {
+    _focus = direction;
+}
+
+void DGTextureManager::terminate() {
+	_isRunning = false;
+	
+	// Idle loaders would otherwise never notice
+	system->signalThread(DGTextureThread);
+}
+
+// Asynchronous method
+bool DGTextureManager::unpack(const GLubyte* payload, long size, GLubyte* target, long targetSize) {
+    vector<DGPackedChunk> arrayOfChunks;
+    uint32_t numChunks;
+    long offset, unpackedSize = 0;
+    int pendingChunks;
+    bool isDamaged = false;
+    
+    if (size < (long)sizeof(numChunks))
+        return false;
+    
+    memcpy(&numChunks, payload, sizeof(numChunks));
+    
+    offset = sizeof(numChunks) + ((long)numChunks * sizeof(TEXChunk));
+    if (offset > size)
+        return false;
+    
+    for (uint32_t i = 0; i < numChunks; i++) {
+        DGPackedChunk packedChunk;
+        
+        memcpy(&packedChunk.chunk, payload + sizeof(numChunks) + (i * sizeof(TEXChunk)), sizeof(TEXChunk));
+        
+        // Everything must fall inside the payload and the target
+        if ((offset + (long)packedChunk.chunk.packedSize > size) ||
+            (unpackedSize + (long)packedChunk.chunk.size > targetSize))
+            return false;
+        
+        packedChunk.source = payload + offset;
+        packedChunk.target = target + unpackedSize;
+        packedChunk.pendingChunks = &pendingChunks;
+        packedChunk.isDamaged = &isDamaged;
+        
+        offset += packedChunk.chunk.packedSize;
+        unpackedSize += packedChunk.chunk.size;
+        
+        arrayOfChunks.push_back(packedChunk);
+    }
+    
+    if (unpackedSize != targetSize)
+        return false;
+    
+    pendingChunks = (int)numChunks;
+    
+    system->suspendThread(DGTextureThread);
+    _arrayOfPackedChunks.insert(_arrayOfPackedChunks.end(), arrayOfChunks.begin(), arrayOfChunks.end());
+    system->signalThread(DGTextureThread); // Waiting loaders may help
+    system->resumeThread(DGTextureThread);
+    
+    // Take chunks until all of ours are done, even those of other payloads.
+    // If none are left, another loader is finishing one of ours, so we
+    // sleep until it's done.
+    for (;;) {
+        DGPackedChunk packedChunk;
+        bool hasChunk = false;
+        
+        system->suspendThread(DGTextureThread);
+        while (pendingChunks && _arrayOfPackedChunks.empty())
+            system->waitForThread(DGTextureThread);
+        
+        if (pendingChunks) {
+            packedChunk = _arrayOfPackedChunks.front();
+            _arrayOfPackedChunks.erase(_arrayOfPackedChunks.begin());
+            hasChunk = true;
+        }
+        system->resumeThread(DGTextureThread);
+        
+        if (hasChunk)
+            _unpackChunk(&packedChunk);
+        else
+            break;
+    }
+    
+    return !isDamaged;
+}
+
+bool DGTextureManager::update() {
+    if (_isRunning) {
+        DGTexture* target = NULL;
+        DGCachedImage cachedImage;
+        DGPackedChunk packedChunk;
+        bool hasCachedImage = false;
+        bool hasChunk = false;
+        
+        string fileToWarm;
+        bool isPreloadedFile = false;
+        
+        // Chunks go first since a loader is waiting on them. Then requested
+        // textures, by priority, preloads, prefetches and files.
+        system->suspendThread(DGTextureThread);
+        if (!_arrayOfPackedChunks.empty()) {
+            packedChunk = _arrayOfPackedChunks.front();
+            _arrayOfPackedChunks.erase(_arrayOfPackedChunks.begin());
+            hasChunk = true;
+        }
+        else if (!_arrayOfQueuedTextures.empty()) {
+            vector<DGTexture*>::iterator it, next;
+            
+            next = _arrayOfQueuedTextures.begin();
+            
+            for (it = next + 1; it != _arrayOfQueuedTextures.end(); it++) {
+                if ((*it)->_priority < (*next)->_priority)
+                    next = it;
+            }
+            
+            target = *next;
+            target->setState(DGTextureDecoding);
+            _arrayOfQueuedTextures.erase(next);
+        }
+        else if (!_arrayOfQueuedPreloads.empty()) {
+            target = _arrayOfQueuedPreloads.front();
+            target->setState(DGTextureDecoding);
+            _arrayOfQueuedPreloads.erase(_arrayOfQueuedPreloads.begin());
+        }
+        else if (!_arrayOfPreloadedFiles.empty()) {
+            fileToWarm = _arrayOfPreloadedFiles.front();
+            _arrayOfPreloadedFiles.erase(_arrayOfPreloadedFiles.begin());
+            isPreloadedFile = true;
+        }
+        else if (!_arrayOfQueuedPrefetches.empty()) {
+            target = _arrayOfQueuedPrefetches.front();
+            target->setState(DGTextureDecoding);
+            _arrayOfQueuedPrefetches.erase(_arrayOfQueuedPrefetches.begin());
+        }
+        else if (!_arrayOfCachedImages.empty()) {
+            cachedImage = _arrayOfCachedImages.front();
+            _arrayOfCachedImages.erase(_arrayOfCachedImages.begin());
+            hasCachedImage = true;
+        }
+        else if (!_arrayOfQueuedFiles.empty()) {
+            fileToWarm = _arrayOfQueuedFiles.front();
+            _arrayOfQueuedFiles.erase(_arrayOfQueuedFiles.begin());
+        }
+        else if (_isRunning) {
+            // Nothing to do, so sleep until something is queued
+            system->waitForThread(DGTextureThread);
+        }
+        system->resumeThread(DGTextureThread);
+        
+        if (hasChunk)
+            _unpackChunk(&packedChunk);
+        
+        if (hasCachedImage)
+            _writeCachedImage(&cachedImage);
+        
+        if (!fileToWarm.empty())
+            _warmFile(fileToWarm.c_str());
+        
+        if (isPreloadedFile) {
+            system->suspendThread(DGTextureThread);
+            _numPendingFiles = max(_numPendingFiles - 1, 0);
+            system->resumeThread(DGTextureThread);
+        }
+        
+        if (target) {
+            // The expensive part, performed without holding the lock
+            target->decode();
+            
+            system->suspendThread(DGTextureThread);
+            target->setState(DGTextureDecoded);
+            _arrayOfDecodedTextures.push_back(target);
+            system->resumeThread(DGTextureThread);
+        }
+        
+        return true;
+    }
+    
+    return false;
+}
+
+////////////////////////////////////////////////////////////
+// Implementation - Private methods
+////////////////////////////////////////////////////////////
+
+// Blocks in the LZ4 format, without the frame around them
+bool DGTextureManager::_decodeLZ4(const GLubyte* source, uint32_t size, GLubyte* target, uint32_t targetSize) {
+    const GLubyte* sourceEnd = source + size;
+    GLubyte* output = target;
+    GLubyte* outputEnd = target + targetSize;
+    
+    while (source < sourceEnd) {
+        unsigned int token = *source++;
+        uint32_t length = token >> 4;
+        uint32_t offset;
+        
+        if (length == 15) {
+            unsigned int byte;
+            
+            do {
+                if (source == sourceEnd)
+                    return false;
+                
+                byte = *source++;
+                length += byte;
+            } while (byte == 255);
+        }
+        
+        if ((length > (uint32_t)(sourceEnd - source)) || (length > (uint32_t)(outputEnd - output)))
+            return false;
+        
+        memcpy(output, source, length);
+        source += length;
+        output += length;
+        
+        // The last sequence has literals only
+        if (source == sourceEnd)
+            break;
+        
+        if ((sourceEnd - source) < 2)
+            return false;
+        
+        offset = source[0] | (source[1] << 8);
+        source += 2;
+        
+        if (!offset || (offset > (uint32_t)(output - target)))
+            return false;
+        
+        length = token & 0x0f;
+        
+        if (length == 15) {
+            unsigned int byte;
+            
+            do {
+                if (source == sourceEnd)
+                    return false;
+                
+                byte = *source++;
+                length += byte;
+            } while (byte == 255);
+        }
+        
+        length += 4;
+        
+        if (length > (uint32_t)(outputEnd - output))
+            return false;
+        
+        // Byte by byte, since the match may overlap what it writes
+        const GLubyte* match = output - offset;
+        
+        while (length--)
+            *output++ = *match++;
+    }
+    
+    return (output == outputEnd);
+}
+
+void DGTextureManager::_evict() {
+    vector<DGTexture*>::iterator it;
+    DGTexture* texture;
+    long budget = (long)config->textureBudget * 1024 * 1024;
+    long lowWater;
+    long usedBytes = 0;
+    int distance = 0;
+    
+    for (texture = _leastRecentTexture; texture; texture = texture->_nextActive) {
+        usedBytes += texture->size();
+        distance = max(distance, texture->_distance);
+    }
+    
+    it = _arrayOfPrefetchedTextures.begin();
+    
+    while (it != _arrayOfPrefetchedTextures.end()) {
+        usedBytes += (*it)->size();
+        it++;
+    }
+    
+    if (usedBytes <= budget)
+        return;
+    
+    // Leave some room, so that the next textures don't evict right away
+    lowWater = (budget / 100) * max(0, min(config->textureLowWater, 100));
+    
+    system->suspendThread(DGTextureThread);
+    
+    // The farthest rooms go first, from their least recent texture
+    texture = _leastRecentTexture;
+    
+    while ((distance >= 0) && (usedBytes > lowWater)) {
+        if (!texture) {
+            texture = _leastRecentTexture;
+            distance--;
+            continue;
+        }
+        
+        DGTexture* next = texture->_nextActive;
+        
+        // Nearer rooms wait for their turn, and textures shared by
+        // others stay until those are evicted
+        if ((texture->_distance != distance) || texture->_numShares ||
+            (find(_arrayOfPinnedTextures.begin(), _arrayOfPinnedTextures.end(),
+                  texture) != _arrayOfPinnedTextures.end()) ||
+            (find(_arrayOfVisibleTiles.begin(), _arrayOfVisibleTiles.end(),
+                  texture) != _arrayOfVisibleTiles.end())) {
+            texture = next;
+            continue;
+        }
+        
+        switch (texture->state()) {
+            case DGTextureDecoding:
+                // A loader owns this one, leave it for later
+                texture = next;
+                continue;
+            case DGTextureQueued: {
+                // Preloads and prefetches wait in queues of their own
+                vector<DGTexture*>* arrayOfQueues[] = {&_arrayOfQueuedTextures, &_arrayOfQueuedPreloads,
+                    &_arrayOfQueuedPrefetches};
+                
+                for (int i = 0; i < 3; i++) {
+                    it = find(arrayOfQueues[i]->begin(), arrayOfQueues[i]->end(), texture);
+                    
+                    if (it != arrayOfQueues[i]->end()) {
+                        arrayOfQueues[i]->erase(it);
+                        break;
+                    }
+                }
+                
+                break;
+            }
+            case DGTextureDecoded:
+                _arrayOfDecodedTextures.erase(find(_arrayOfDecodedTextures.begin(),
+                                                   _arrayOfDecodedTextures.end(), texture));
+                break;
+            case DGTextureUploading:
+                _arrayOfUploadingTextures.erase(find(_arrayOfUploadingTextures.begin(),
+                                                     _arrayOfUploadingTextures.end(), texture));
+                break;
+        }
+        
+        usedBytes -= texture->size();
+        
+        texture->setState(DGTextureIdle);
+        texture->unload();
+        _unlink(texture);
+        _evictions++;
+        
+        texture = next;
+    }
+    
+    system->resumeThread(DGTextureThread);
+}
+
+// A texture in use with the same contents, whose GL texture may be shared
+DGTexture* DGTextureManager::_findOriginal(DGTexture* texture) {
+    DGTexture* candidate;
+    
+    if (!texture->_hash)
+        return NULL;
+    
+    for (candidate = _leastRecentTexture; candidate; candidate = candidate->_nextActive) {
+        if ((candidate != texture) && candidate->_isLoaded && !candidate->_original &&
+            (candidate->_hash == texture->_hash))
+            return candidate;
+    }
+    
+    return NULL;
+}
+
+// The first part of each frame always goes through, so that uploads never stall
+bool DGTextureManager::_isWithinBudget(long size) {
+    if (config->uploadBudget && (size > _uploadBytes))
+        return false;
+    
+    if (config->uploadTime &&
+        ((system->monotonicTime() - _uploadStart) * 1000.0 >= config->uploadTime))
+        return false;
+    
+    return true;
+}
+
+void DGTextureManager::_link(DGTexture* texture) {
+    texture->_previousActive = _mostRecentTexture;
+    texture->_nextActive = NULL;
+    
+    if (_mostRecentTexture)
+        _mostRecentTexture->_nextActive = texture;
+    else
+        _leastRecentTexture = texture;
+    
+    _mostRecentTexture = texture;
+    texture->_isActive = true;
+}
+
+void DGTextureManager::_loadAtlasIndex() {
+    char indexFile[DGMaxFileLength];
+    char bundleFile[DGMaxFileLength];
+    char* extension;
+    char line[DGMaxFileLength + 64];
+    vector<DGTexture*> arrayOfPages;
+    FILE* fh;
+    
+    _hasAtlasIndex = true;
+    
+    snprintf(indexFile, DGMaxFileLength, "%s", config->path(DGPathRes, DGAtlasIndex, DGObjectImage));
+    fh = fopen(indexFile, "r");
+    
+    // Not an error, images are simply packed at runtime
+    if (!fh)
+        return;
+    
+    // The pages are in a bundle with the same name
+    snprintf(bundleFile, DGMaxFileLength, "%s", indexFile);
+    extension = strrchr(bundleFile, '.');
+    if (!extension || ((extension - bundleFile) + sizeof(".tex") > DGMaxFileLength)) {
+        fclose(fh);
+        return;
+    }
+    
+    strcpy(extension, ".tex");
+    
+    while (fgets(line, sizeof(line), fh)) {
+        char fileName[DGMaxFileLength];
+        int page, x, y, width, height;
+        
+        if (sscanf(line, "%255s %d %d %d %d %d", fileName, &page, &x, &y, &width, &height) != 6)
+            continue;
+        
+        if (page < 0)
+            continue;
+        
+        // Load the pages as they are referenced
+        while (page >= (int)arrayOfPages.size()) {
+            DGTexture* texture = new DGTexture;
+            
+            texture->setResource(bundleFile);
+            texture->setIndexInBundle((int)arrayOfPages.size());
+            texture->load();
+            
+            _arrayOfTextures.push_back(texture);
+            arrayOfPages.push_back(texture);
+        }
+        
+        DGAtlasImage image;
+        float u0 = (float)x / DGAtlasSize;
+        float v0 = (float)y / DGAtlasSize;
+        float u1 = (float)(x + width) / DGAtlasSize;
+        float v1 = (float)(y + height) / DGAtlasSize;
+        float texCoords[] = {u0, v0, u1, v0, u1, v1, u0, v1};
+        
+        image.fileName = fileName;
+        image.texture = arrayOfPages[page];
+        image.size.width = width;
+        image.size.height = height;
+        image.hash = 0;
+        memcpy(image.arrayOfTexCoords, texCoords, sizeof(texCoords));
+        
+        _arrayOfAtlasImages.push_back(image);
+    }
+    
+    fclose(fh);
+}
+
+bool DGTextureManager::_loadTiles(DGTileSet* tileSet) {
+    TEXMainHeaderV2 header;
+    vector<TEXEntry> arrayOfEntries;
+    int levelWidth[TEXMaxLevels];
+    int levelHeight[TEXMaxLevels];
+    char ident[8];
+    long fileSize;
+    FILE* fh;
+    
+    // Not tried again if this fails
+    tileSet->isLoaded = true;
+    
+    fh = fopen(tileSet->fileName.c_str(), "rb");
+    
+    if (!fh) {
+        log->error(DGModTexture, "%s: %s", DGMsg210000, tileSet->fileName.c_str());
+        return false;
+    }
+    
+    fseek(fh, 0, SEEK_END);
+    fileSize = ftell(fh);
+    fseek(fh, 0, SEEK_SET);
+    
+    // Only the directory is read here, and it must fit in the file
+    // before we trust its size
+    if ((fread(ident, 1, sizeof(ident), fh) != sizeof(ident)) ||
+        (fread(&header, 1, sizeof(header), fh) != sizeof(header)) ||
+        (memcmp(TEXIdentV2, ident, 7) != 0) || (header.version != TEXVersion) ||
+        !header.numTextures || !header.tileSize ||
+        ((fileSize - (long)(sizeof(ident) + sizeof(header))) / (long)sizeof(TEXEntry) <
+         (long)header.numTextures)) {
+        log->error(DGModTexture, "%s: %s", DGMsg210002, tileSet->fileName.c_str());
+        fclose(fh);
+        
+        return false;
+    }
+    
+    arrayOfEntries.resize(header.numTextures);
+    
+    if (fread(&arrayOfEntries[0], sizeof(TEXEntry), header.numTextures, fh) != header.numTextures) {
+        log->error(DGModTexture, "%s: %s", DGMsg210002, tileSet->fileName.c_str());
+        fclose(fh);
+        
+        return false;
+    }
+    
+    fclose(fh);
+    
+    // Same for the payloads, as a tile out of bounds would only fail
+    // once the player looks at it
+    for (unsigned int i = 0; i < arrayOfEntries.size(); i++) {
+        if (((uint64_t)arrayOfEntries[i].offset + arrayOfEntries[i].size > (uint64_t)fileSize) ||
+            !arrayOfEntries[i].width || !arrayOfEntries[i].height) {
+            log->error(DGModTexture, "%s: %s", DGMsg210002, tileSet->fileName.c_str());
+            
+            return false;
+        }
+    }
+    
+    // Levels may be cut unevenly, so their sizes are taken from their tiles
+    for (int level = 0; level < TEXMaxLevels; level++) {
+        levelWidth[level] = 0;
+        levelHeight[level] = 0;
+    }
+    
+    for (unsigned int i = 0; i < arrayOfEntries.size(); i++) {
+        uint32_t position = arrayOfEntries[i].cubePosition;
+        int level = TEXTileLevel(position);
+        
+        levelWidth[level] = max(levelWidth[level], (int)(TEXTileX(position) * header.tileSize +
+                                                          arrayOfEntries[i].width));
+        levelHeight[level] = max(levelHeight[level], (int)(TEXTileY(position) * header.tileSize +
+                                                            arrayOfEntries[i].height));
+        tileSet->numLevels = max(tileSet->numLevels, level + 1);
+    }
+    
+    tileSet->faceSize = levelWidth[0];
+    
+    // The smallest level goes first, to be drawn below the others
+    for (int level = tileSet->numLevels - 1; level >= 0; level--) {
+        for (unsigned int i = 0; i < arrayOfEntries.size(); i++) {
+            TEXEntry &entry = arrayOfEntries[i];
+            
+            if ((int)TEXTileLevel(entry.cubePosition) != level)
+                continue;
+            
+            DGTile tile;
+            DGTexture* texture = new DGTexture;
+            float x = (float)(TEXTileX(entry.cubePosition) * header.tileSize);
+            float y = (float)(TEXTileY(entry.cubePosition) * header.tileSize);
+            
+            texture->setResource(tileSet->fileName.c_str());
+            texture->setIndexInBundle(i);
+            
+            // Known in advance, so that the budget isn't overestimated
+            texture->_width = entry.width;
+            texture->_height = entry.height;
+            
+            registerTexture(texture);
+            
+            tile.texture = texture;
+            tile.face = TEXTileFace(entry.cubePosition) % DGNumberOfFaces;
+            tile.level = level;
+            tile.coords[0] = x / levelWidth[level];
+            tile.coords[1] = y / levelHeight[level];
+            tile.coords[2] = (x + entry.width) / levelWidth[level];
+            tile.coords[3] = (y + entry.height) / levelHeight[level];
+            tile.center = DGMakeFacePoint(tile.face, (tile.coords[0] + tile.coords[2]) / 2.0,
+                                          (tile.coords[1] + tile.coords[3]) / 2.0);
+            tile.radius = 0.0f;
+            
+            // The cone goes through the farthest corner
+            for (int corner = 0; corner < 4; corner++) {
+                DGVector point = DGMakeFacePoint(tile.face, tile.coords[(corner & 1) ? 2 : 0],
+                                                 tile.coords[(corner & 2) ? 3 : 1]);
+                double dot = (point.x * tile.center.x) + (point.y * tile.center.y) + (point.z * tile.center.z);
+                double lengths = sqrt((point.x * point.x) + (point.y * point.y) + (point.z * point.z)) *
+                                 sqrt((tile.center.x * tile.center.x) + (tile.center.y * tile.center.y) +
+                                      (tile.center.z * tile.center.z));
+                
+                tile.radius = max(tile.radius, (float)acos(min(dot / lengths, 1.0)));
+            }
+            
+            tileSet->arrayOfTiles.push_back(tile);
+        }
+    }
+    
+    return !tileSet->arrayOfTiles.empty();
+}
+
+GLubyte* DGTextureManager::_mapFile(const char* fileName, long* size) {
+    GLubyte* data = NULL;
+    
+#ifdef DGPlatformWindows
+    HANDLE hFile, hMapping;
+    LARGE_INTEGER fileSize;
+    
+    hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+    
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart) {
+        hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        
+        if (hMapping) {
+            // The view keeps its own reference to the mapping
+            data = (GLubyte*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(hMapping);
+        }
+    }
+    
+    CloseHandle(hFile);
+    
+    if (data)
+        *size = (long)fileSize.QuadPart;
+#else
+    struct stat fileInfo;
+    int fd;
+    
+    fd = open(fileName, O_RDONLY);
+    
+    if (fd < 0)
+        return NULL;
+    
+    if ((fstat(fd, &fileInfo) == 0) && fileInfo.st_size) {
+        void* mapping = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        
+        if (mapping != MAP_FAILED) {
+            data = (GLubyte*)mapping;
+            *size = (long)fileInfo.st_size;
+        }
+    }
+    
+    // The mapping remains valid after closing the descriptor
+    close(fd);
+#endif
+    
+    return data;
+}
+
+bool DGTextureManager::_pack(DGTexture* image, DGAtlasImage* target) {
+    vector<DGAtlasPage>::iterator it;
+    int width = image->width() + (DGAtlasBorder * 2);
+    int height = image->height() + (DGAtlasBorder * 2);
+    int channels = image->depth();
+    int x = 0, y = 0;
+    
+    if ((channels < 1) || (channels > 4))
+        return false;
+    
+    // Shelves are filled from left to right, opening a new one below
+    // when the image doesn't fit
+    it = _arrayOfAtlasPages.begin();
+    
+    while (it != _arrayOfAtlasPages.end()) {
+        DGAtlasPage* page = &(*it);
+        
+        if ((page->shelfX + width) > DGAtlasSize) {
+            page->shelfX = 0;
+            page->shelfY += page->shelfHeight;
+            page->shelfHeight = 0;
+        }
+        
+        if ((page->shelfY + height) <= DGAtlasSize)
+            break;
+        
+        it++;
+    }
+    
+    if (it == _arrayOfAtlasPages.end()) {
+        DGAtlasPage page;
+        
+        page.texture = new DGTexture(DGAtlasSize, DGAtlasSize, 32);
+        page.shelfX = 0;
+        page.shelfY = 0;
+        page.shelfHeight = 0;
+        
+        _arrayOfTextures.push_back(page.texture);
+        _arrayOfAtlasPages.push_back(page);
+        
+        it = _arrayOfAtlasPages.end() - 1;
+    }
+    
+    x = (*it).shelfX;
+    y = (*it).shelfY;
+    
+    (*it).shelfX += width;
+    (*it).shelfHeight = max((*it).shelfHeight, height);
+    
+    // Copy the image surrounded by its own edges
+    GLubyte* bitmap = (GLubyte*)malloc(width * height * channels);
+    
+    for (int row = 0; row < height; row++) {
+        int sourceRow = min(max(row - DGAtlasBorder, 0), image->height() - 1);
+        
+        for (int column = 0; column < width; column++) {
+            int sourceColumn = min(max(column - DGAtlasBorder, 0), image->width() - 1);
+            
+            memcpy(&bitmap[(row * width + column) * channels],
+                   &image->_bitmap[(sourceRow * image->width() + sourceColumn) * channels], channels);
+        }
+    }
+    
+    (*it).texture->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, image->_format, GL_UNSIGNED_BYTE, bitmap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    chargeUpload(width * height * channels);
+    
+    free(bitmap);
+    
+    x += DGAtlasBorder;
+    y += DGAtlasBorder;
+    
+    float u0 = (float)x / DGAtlasSize;
+    float v0 = (float)y / DGAtlasSize;
+    float u1 = (float)(x + image->width()) / DGAtlasSize;
+    float v1 = (float)(y + image->height()) / DGAtlasSize;
+    float texCoords[] = {u0, v0, u1, v0, u1, v1, u0, v1};
+    
+    target->texture = (*it).texture;
+    memcpy(target->arrayOfTexCoords, texCoords, sizeof(texCoords));
+    
+    return true;
+}
+
+// The angle to the view or the focus, whichever is nearer
+float DGTextureManager::_priorityOf(DGVector direction) {
+    float* look = cameraManager->orientation();
+    double length = sqrt((direction.x * direction.x) + (direction.y * direction.y) +
+                         (direction.z * direction.z));
+    double lookLength = sqrt((look[0] * look[0]) + (look[1] * look[1]) + (look[2] * look[2]));
+    double focusLength = sqrt((_focus.x * _focus.x) + (_focus.y * _focus.y) + (_focus.z * _focus.z));
+    double angle = M_PI;
+    
+    if (length == 0.0)
+        return 0.0f;
+    
+    if (lookLength > 0.0)
+        angle = acos(max(-1.0, min(1.0, ((direction.x * look[0]) + (direction.y * look[1]) +
+                                         (direction.z * look[2])) / (length * lookLength))));
+    
+    if (focusLength > 0.0)
+        angle = min(angle, acos(max(-1.0, min(1.0, ((direction.x * _focus.x) + (direction.y * _focus.y) +
+                                                    (direction.z * _focus.z)) / (length * focusLength)))));
+    
+    return (float)angle;
+}
+
+// Deletes the least recently used files until the cache fits in its budget,
+// returning the size left
+long DGTextureManager::_pruneCache() {
+    vector<DGCacheFile> arrayOfFiles;
+    vector<DGCacheFile>::iterator it;
+    long budget = (long)config->cacheBudget * 1024 * 1024;
+    long size = 0;
+    
+#ifdef DGPlatformWindows
+    WIN32_FIND_DATAA findData;
+    HANDLE findHandle = FindFirstFileA((_cachePath + "*." + DGDefTexExtension).c_str(), &findData);
+    
+    if (findHandle != INVALID_HANDLE_VALUE) {
+        do {
+            DGCacheFile file;
+            struct stat info;
+            
+            file.fileName = _cachePath + findData.cFileName;
+            
+            if (stat(file.fileName.c_str(), &info) == 0) {
+                file.time = info.st_mtime;
+                file.size = (long)info.st_size;
+                arrayOfFiles.push_back(file);
+            }
+        } while (FindNextFileA(findHandle, &findData));
+        
+        FindClose(findHandle);
+    }
+#else
+    DIR* dir = opendir(_cachePath.c_str());
+    
+    if (dir) {
+        struct dirent* dirEntry;
+        
+        while ((dirEntry = readdir(dir)) != NULL) {
+            DGCacheFile file;
+            struct stat info;
+            const char* extension = strrchr(dirEntry->d_name, '.');
+            
+            // Files still being written end in .tmp
+            if (!extension || (strcmp(extension + 1, DGDefTexExtension) != 0))
+                continue;
+            
+            file.fileName = _cachePath + dirEntry->d_name;
+            
+            if (stat(file.fileName.c_str(), &info) == 0) {
+                file.time = info.st_mtime;
+                file.size = (long)info.st_size;
+                arrayOfFiles.push_back(file);
+            }
+        }
+        
+        closedir(dir);
+    }
+#endif
+    
+    for (it = arrayOfFiles.begin(); it != arrayOfFiles.end(); it++)
+        size += (*it).size;
+    
+    while ((size > budget) && !arrayOfFiles.empty()) {
+        vector<DGCacheFile>::iterator oldest = arrayOfFiles.begin();
+        
+        for (it = arrayOfFiles.begin(); it != arrayOfFiles.end(); it++) {
+            if ((*it).time < (*oldest).time)
+                oldest = it;
+        }
+        
+        remove((*oldest).fileName.c_str());
+        size -= (*oldest).size;
+        arrayOfFiles.erase(oldest);
+    }
+    
+    return size;
+}
+
+// Behind the textures of the same or a more urgent class. Moves the
+// texture if it was already waiting.
+void DGTextureManager::_queueUpload(DGTexture* texture, int uploadClass) {
+    vector<DGTexture*>::iterator it;
+    
+    it = find(_arrayOfUploadingTextures.begin(), _arrayOfUploadingTextures.end(), texture);
+    
+    if (it != _arrayOfUploadingTextures.end())
+        _arrayOfUploadingTextures.erase(it);
+    
+    texture->_uploadClass = uploadClass;
+    
+    it = _arrayOfUploadingTextures.begin();
+    
+    while ((it != _arrayOfUploadingTextures.end()) && ((*it)->_uploadClass <= uploadClass))
+        it++;
+    
+    _arrayOfUploadingTextures.insert(it, texture);
+}
+
+void DGTextureManager::_request(DGTexture* target) {
+    vector<DGTexture*>::iterator it;
+    
+    it = find(_arrayOfPrefetchedTextures.begin(), _arrayOfPrefetchedTextures.end(), target);
+    
+    if (it != _arrayOfPrefetchedTextures.end()) {
+        // The texture was prefetched, so it's either ready or on its way.
+        // If a loader didn't pick it yet, we raise its priority.
+        _arrayOfPrefetchedTextures.erase(it);
+        
+        if (target->state() == DGTextureUploading)
+            _queueUpload(target, DGUploadVisible);
+        
+        system->suspendThread(DGTextureThread);
+        it = find(_arrayOfQueuedPrefetches.begin(), _arrayOfQueuedPrefetches.end(), target);
+        if (it != _arrayOfQueuedPrefetches.end()) {
+            _arrayOfQueuedPrefetches.erase(it);
+            _arrayOfQueuedTextures.push_back(target);
+        }
+        system->resumeThread(DGTextureThread);
+        
+        _hits++;
+    }
+    else if (target->state() == DGTextureQueued) {
+        // Preloaded, and now needed in view
+        system->suspendThread(DGTextureThread);
+        it = find(_arrayOfQueuedPreloads.begin(), _arrayOfQueuedPreloads.end(), target);
+        if (it != _arrayOfQueuedPreloads.end()) {
+            _arrayOfQueuedPreloads.erase(it);
+            target->_priority = 0.0f;
+            _arrayOfQueuedTextures.push_back(target);
+        }
+        system->resumeThread(DGTextureThread);
+        
+        _hits++;
+    }
+    else if (!target->isLoaded() && !target->isPending()) {
+        // Faces take only the levels the screen needs
+        target->_resolution = target->_isFace ? cameraManager->faceResolution() : 0;
+        
+        system->suspendThread(DGTextureThread);
+        target->setState(DGTextureQueued);
+        _arrayOfQueuedTextures.push_back(target);
+        system->signalThread(DGTextureThread);
+        system->resumeThread(DGTextureThread);
+        
+        _misses++;
+    }
+    else _hits++;
+    
+    // Move it to the most recent end, or add it if it wasn't active
+    if (target->_isActive)
+        _unlink(target);
+    
+    _link(target);
+    
+    target->increaseUsageCount();
+}
+
+void DGTextureManager::_unlink(DGTexture* texture) {
+    if (texture->_previousActive)
+        texture->_previousActive->_nextActive = texture->_nextActive;
+    else
+        _leastRecentTexture = texture->_nextActive;
+    
+    if (texture->_nextActive)
+        texture->_nextActive->_previousActive = texture->_previousActive;
+    else
+        _mostRecentTexture = texture->_previousActive;
+    
+    texture->_previousActive = NULL;
+    texture->_nextActive = NULL;
+    texture->_isActive = false;
+}
+
+void DGTextureManager::_unmapFile(GLubyte* data, long size) {
+#ifdef DGPlatformWindows
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+// Unpacks and checks a chunk, then tells the loader waiting on it
+void DGTextureManager::_unpackChunk(DGPackedChunk* packedChunk) {
+    TEXChunk* chunk = &packedChunk->chunk;
+    bool isValid = false;
+    
+    switch (chunk->codec) {
+        case TEXCodecStored:
+            if (chunk->packedSize == chunk->size) {
+                memcpy(packedChunk->target, packedChunk->source, chunk->size);
+                isValid = true;
+            }
+            break;
+        case TEXCodecZlib:
+            isValid = (stbi_zlib_decode_buffer((char*)packedChunk->target, chunk->size,
+                                               (const char*)packedChunk->source,
+                                               chunk->packedSize) == (int)chunk->size);
+            break;
+        case TEXCodecLZ4:
+            isValid = _decodeLZ4(packedChunk->source, chunk->packedSize,
+                                 packedChunk->target, chunk->size);
+            break;
+    }
+    
+    if (isValid)
+        isValid = (TEXChecksum(packedChunk->target, chunk->size) == chunk->checksum);
+    
+    system->suspendThread(DGTextureThread);
+    if (!isValid)
+        *packedChunk->isDamaged = true;
+    
+    (*packedChunk->pendingChunks)--;
+    system->signalThread(DGTextureThread);
+    system->resumeThread(DGTextureThread);
+}
+
+void DGTextureManager::_updateVisibleTiles(vector<DGTexture*> &arrayOfTiles) {
+    vector<DGTexture*> arrayOfCancelledTiles;
+    vector<DGTexture*>::iterator it;
+    
+    // Tiles that left the view before a loader picked them are cancelled,
+    // the rest are simply left to be evicted
+    it = _arrayOfVisibleTiles.begin();
+    
+    while (it != _arrayOfVisibleTiles.end()) {
+        if (((*it)->state() == DGTextureQueued) &&
+            (find(arrayOfTiles.begin(), arrayOfTiles.end(), *it) == arrayOfTiles.end()))
+            arrayOfCancelledTiles.push_back(*it);
+        
+        it++;
+    }
+    
+    _arrayOfVisibleTiles.swap(arrayOfTiles);
+    
+    if (arrayOfCancelledTiles.empty())
+        return;
+    
+    system->suspendThread(DGTextureThread);
+    
+    it = arrayOfCancelledTiles.begin();
+    
+    while (it != arrayOfCancelledTiles.end()) {
+        vector<DGTexture*>::iterator queued = find(_arrayOfQueuedTextures.begin(),
+                                                   _arrayOfQueuedTextures.end(), *it);
+        
+        // Check again, a loader may have picked it meanwhile
+        if (queued != _arrayOfQueuedTextures.end()) {
+            _arrayOfQueuedTextures.erase(queued);
+            (*it)->setState(DGTextureIdle);
+            _unlink(*it);
+        }
+        
+        it++;
+    }
+    
+    system->resumeThread(DGTextureThread);
+}
+
+// Faces loaded for a smaller screen are queued again to get the levels
+// they lack, and drawn as they are in the meantime
+void DGTextureManager::_upgrade(int resolution) {
+    DGTexture* texture;
+    
+    system->suspendThread(DGTextureThread);
+    
+    for (texture = _leastRecentTexture; texture; texture = texture->_nextActive) {
+        if (!texture->_isFace)
+            continue;
+        
+        // Those waiting for a loader simply take the new size
+        if (texture->state() == DGTextureQueued) {
+            texture->_resolution = resolution;
+            continue;
+        }
+        
+        // Shared textures are left alone, as others draw with them
+        if (!texture->_isLoaded || texture->_original || texture->_numShares ||
+            (texture->state() != DGTextureIdle))
+            continue;
+        
+        if (texture->_levelFor(resolution) < texture->_firstLevel) {
+            texture->_keepAsPreview();
+            texture->_resolution = resolution;
+            texture->setState(DGTextureQueued);
+            _arrayOfQueuedTextures.push_back(texture);
+        }
+    }
+    
+    system->signalThread(DGTextureThread);
+    system->resumeThread(DGTextureThread);
+}
+
+void DGTextureManager::_warmFile(const char* fileName) {
+    FILE* fh;
+    
+    fh = fopen(fileName, "rb");
+    
+    if (fh != NULL) {
+        char buffer[8192];
+        long bytesRead = 0;
+        size_t count;
+        
+        // The data is discarded, what we want is the file in the system cache
+        while ((bytesRead < DGMaxWarmedBytes) && (count = fread(buffer, 1, sizeof(buffer), fh)))
+            bytesRead += count;
+        
+        fclose(fh);
+    }
+}
+
+// Writes a bundle with a single image, so that textures read it as any other
+void DGTextureManager::_writeCachedImage(DGCachedImage* cachedImage) {
+    TEXMainHeaderV2 header;
+    TEXEntry entry = cachedImage->entry;
+    string temporaryFile = cachedImage->fileName + ".tmp";
+    char ident[8];
+    bool isWritten = false;
+    FILE* fh;
+    
+    memset(ident, 0, sizeof(ident));
+    memset(&header, 0, sizeof(header));
+    
+    strncpy(ident, TEXIdentV2, sizeof(ident));
+    header.version = TEXVersion;
+    header.numTextures = 1;
+    header.compressionLevel = 1;
+    
+    // The payload is read whole, so it needs no alignment
+    entry.offset = sizeof(ident) + sizeof(header) + sizeof(entry);
+    
+    fh = fopen(temporaryFile.c_str(), "wb");
+    
+    if (fh) {
+        isWritten = (fwrite(ident, 1, sizeof(ident), fh) == sizeof(ident)) &&
+                    (fwrite(&header, 1, sizeof(header), fh) == sizeof(header)) &&
+                    (fwrite(&entry, 1, sizeof(entry), fh) == sizeof(entry)) &&
+                    (fwrite(cachedImage->data, 1, entry.size, fh) == entry.size);
+        
+        fclose(fh);
+    }
+    
+    free(cachedImage->data);
+    
+    // Renamed once complete, so that no loader reads it halfway
+    remove(cachedImage->fileName.c_str());
+    
+    if (isWritten && (rename(temporaryFile.c_str(), cachedImage->fileName.c_str()) == 0)) {
+        bool isFull;
+        
+        system->suspendThread(DGTextureThread);
+        _cacheSize += entry.offset + entry.size;
+        isFull = (_cacheSize > ((long)config->cacheBudget * 1024 * 1024));
+        system->resumeThread(DGTextureThread);
+        
+        if (isFull) {
+            long size = _pruneCache();
+            
+            system->suspendThread(DGTextureThread);
+            _cacheSize = size;
+            system->resumeThread(DGTextureThread);
+        }
+    }
+    else remove(temporaryFile.c_str());
 }
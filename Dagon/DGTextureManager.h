@@ -17,6 +17,8 @@
 // Headers
 ////////////////////////////////////////////////////////////
 
+#include <map>
+
 #include "DGPlatform.h"
 #include "DGTexture.h"
 
@@ -24,39 +26,316 @@
 // Definitions
 ////////////////////////////////////////////////////////////
 
-// TODO: This class should be a singleton
+// Files warmed up by the loaders are only read up to this amount,
+// which is enough to cover the headers and first frames of videos
+#define DGMaxWarmedBytes (4 * 1024 * 1024)
+
+// Textures preloaded for a room wait behind anything requested, even
+// the farthest tiles, and ahead of prefetches
+#define DGPreloadPriority 100.0f
+
+typedef struct {
+    DGTexture* texture;
+    int shelfX;
+    int shelfY;
+    int shelfHeight;
+} DGAtlasPage;
+
+typedef struct {
+    std::string fileName;
+    DGTexture* texture; // Either a page or a texture of its own
+    float arrayOfTexCoords[8];
+    DGSize size;
+    uint64_t hash; // Of the contents, zero for images baked in pages
+} DGAtlasImage;
+
+// A version 2 bundle mapped into memory, kept for the lifetime of the
+// manager so that repeated visits to a node are served by the system cache
+typedef struct {
+    GLubyte* data;
+    long size;
+} DGMappedBundle;
+
+// Images compressed by the driver are kept in a cache, one bundle per image,
+// named after the file, its time and size, and the driver
+typedef struct {
+    std::string fileName;
+    TEXEntry entry;
+    GLubyte* data;
+} DGCachedImage;
 
-// This is temporary until we actually test how much memory is available.
-// NOT accurate! It's only a reference value since textures are flushed
-// before the next switch.
-#define DGMaxActiveTextures 6
+typedef struct {
+    std::string fileName;
+    time_t time; // Refreshed on every hit
+    long size;
+} DGCacheFile;
+
+// Faces too big to be resident at once are streamed in tiles, requested
+// as they come into view and at the level the screen needs
+typedef struct {
+    DGTexture* texture;
+    int face;
+    int level; // Zero is the full size
+    float coords[4]; // Covered part of the face, from 0 to 1
+    DGVector center; // For culling
+    float radius; // Angle from the center to the corners
+} DGTile;
+
+typedef struct DGTileSet {
+    std::string fileName;
+    bool isLoaded; // Tiles are created on the first visit
+    int faceSize; // Of the full size
+    int numLevels;
+    std::vector<DGTile> arrayOfTiles; // The smallest level first
+} DGTileSet;
+
+// Decoded textures are uploaded through a ring of pixel buffers, so that
+// the driver copies the data while the frame goes on. Anything bigger
+// than a buffer is read straight from memory.
+#define DGUploadBuffers     3
+#define DGUploadBufferSize  (4 * 1024 * 1024)
+
+typedef struct {
+    GLuint ident;
+    GLsync fence; // Signaled once GL is done reading from the buffer
+} DGUploadBuffer;
+
+// Textures waiting for the upload budget go by class, and then in
+// order of arrival
+enum DGUploadClasses {
+    DGUploadVisible = 0, // Requested by the current node
+    DGUploadInterface,
+    DGUploadPrefetch
+};
 
+// Chunks of a packed payload are queued so that idle loaders help unpacking it
+typedef struct {
+    const GLubyte* source;
+    GLubyte* target;
+    TEXChunk chunk;
+    int* pendingChunks; // Shared by all the chunks of the payload
+    bool* isDamaged;
+} DGPackedChunk;
+
+class DGCameraManager;
 class DGConfig;
 class DGLog;
 class DGNode;
+class DGSystem;
 
 ////////////////////////////////////////////////////////////
-// Interface
+// Interface - Singleton class
 ////////////////////////////////////////////////////////////
 
 class DGTextureManager {
+    DGCameraManager* cameraManager;
     DGConfig* config;
     DGLog* log;
+    DGSystem* system;
     
-    std::vector<DGTexture*> _arrayOfActiveTextures;
+    std::vector<DGAtlasImage> _arrayOfAtlasImages;
+    std::string _cachePath;
+    long _cacheSize; // Shared with the loaders
+    std::string _driverIdent;
+    std::vector<DGAtlasPage> _arrayOfAtlasPages;
+    std::map<std::string, DGMappedBundle> _mapOfBundles; // Shared with the loaders
+    std::vector<DGTexture*> _arrayOfPinnedTextures;
+    std::vector<DGTexture*> _arrayOfPrefetchedTextures;
+    std::vector<DGTexture*> _arrayOfPreloadedTextures; // Pinned until the next switch
+    std::vector<DGTexture*> _arrayOfRequestedTextures;
     std::vector<DGTexture*> _arrayOfTextures;
+    std::vector<DGTileSet*> _arrayOfTileSets;
+    std::vector<DGTexture*> _arrayOfUploadingTextures; // Resumed every frame, see DGUploadClasses
+    std::vector<DGTexture*> _arrayOfVisibleTiles; // Pinned as well
     
-public:
+    // These are shared with the loaders, so always access them
+    // while the texture thread is suspended
+    std::vector<DGCachedImage> _arrayOfCachedImages;
+    std::vector<DGTexture*> _arrayOfDecodedTextures;
+    std::vector<DGPackedChunk> _arrayOfPackedChunks;
+    std::vector<std::string> _arrayOfQueuedFiles;
+    std::vector<DGTexture*> _arrayOfQueuedPrefetches;
+    std::vector<DGTexture*> _arrayOfQueuedPreloads;
+    std::vector<DGTexture*> _arrayOfQueuedTextures;
+    std::vector<std::string> _arrayOfPreloadedFiles;
+    int _numPendingFiles; // Preloaded files not warmed yet
+    
+    // Active textures, evicted from the least recent one
+    DGTexture* _leastRecentTexture;
+    DGTexture* _mostRecentTexture;
+    
+    DGVector _focus; // Where the player clicked last
+    int _numPreloadedFiles;
+    int _faceResolution; // Faces loaded for a smaller one are upgraded as it grows
+    
+    DGUploadBuffer _arrayOfUploadBuffers[DGUploadBuffers];
+    int _currentUploadBuffer;
+    bool _hasUploadBuffers;
+    long _chargedBytes; // Uploaded right away since the last frame
+    bool _hasUploaded; // Anything this frame
+    bool _isStaging; // A buffer is bound
+    long _uploadBytes; // Left for this frame
+    double _uploadStart; // Monotonic, in seconds
+    
+    // For profiling
+    unsigned long _deferredBytes;
+    unsigned long _evictions;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _sharedImageBytes;
+    unsigned long _uploadedBytes;
+    
+    bool _hasAtlasIndex;
+    bool _isRunning;
+    
+    bool _decodeLZ4(const GLubyte* source, uint32_t size, GLubyte* target, uint32_t targetSize);
+    void _evict();
+    DGTexture* _findOriginal(DGTexture* texture);
+    bool _isWithinBudget(long size);
+    void _link(DGTexture* texture);
+    void _loadAtlasIndex();
+    bool _loadTiles(DGTileSet* tileSet);
+    GLubyte* _mapFile(const char* fileName, long* size);
+    bool _pack(DGTexture* image, DGAtlasImage* target);
+    float _priorityOf(DGVector direction);
+    long _pruneCache();
+    void _queueUpload(DGTexture* texture, int uploadClass);
+    void _request(DGTexture* target);
+    void _unlink(DGTexture* texture);
+    void _unmapFile(GLubyte* data, long size);
+    void _unpackChunk(DGPackedChunk* packedChunk);
+    void _updateVisibleTiles(std::vector<DGTexture*> &arrayOfTiles);
+    void _upgrade(int resolution);
+    void _warmFile(const char* fileName);
+    void _writeCachedImage(DGCachedImage* cachedImage);
+    
+    // Private constructor/destructor
     DGTextureManager();
     ~DGTextureManager();
+    // Stop the compiler generating methods of copy the object
+    DGTextureManager(DGTextureManager const& copy);            // Not implemented
+    DGTextureManager& operator=(DGTextureManager const& copy); // Not implemented
+    
+public:
+    static DGTextureManager& getInstance() {
+        // The only instance
+        // Guaranteed to be lazy initialized
+        // Guaranteed that it will be destroyed correctly
+        static DGTextureManager instance;
+        return instance;
+    }
     
+    // Profiling
+    
+    // Left waiting for the next frames when the budget ran out, roughly
+    unsigned long deferredBytes();
+    unsigned long evictions();
+    unsigned long hits();
+    unsigned long misses();
+    
+    // Bytes not taken in video memory because identical textures share theirs
+    unsigned long sharedBytes();
+    unsigned long uploadedBytes(); // In the last frame
+    
+    // Streaming uploads
+    
+    // Copies the data into a free pixel buffer, left bound until the upload
+    // ends, and points to what GL should read in its place. Returns false
+    // if the budget for this frame is spent, in bytes or time, though the
+    // first part always goes through.
+    bool beginUpload(const GLubyte* data, long size, const GLvoid** pixels);
+    
+    // Uploads that can't wait, like video frames or glyphs, count against
+    // the budget as well, leaving less for the streamed ones next frame
+    void chargeUpload(long size);
+    void endUpload();
+    
+    // The size of the next part worth uploading, at most a buffer
+    long uploadBytes();
+    
+    // Appends the tiles of the smallest level, enough to draw the whole
+    // node, so that they are prefetched
+    void appendBaseTiles(DGTileSet* tileSet, std::vector<DGTexture*> &arrayOfTextures);
     void appendTextureToBundle(const char* nameOfBundle, DGTexture* textureToAppend);
+    
+    // Takes the data of an image compressed by the driver, written by the
+    // loaders to the given file in the cache
+    void cacheImage(const char* cacheFile, TEXEntry* entry, GLubyte* data);
     void createBundle(const char* nameOfBundle);
+    
+    // Writes where the compressed copy of the image goes in the cache, which
+    // takes DGMaxPathLength + DGMaxFileLength. Returns true if it's already
+    // there. If the cache is disabled the file is left empty.
+    bool findCachedImage(const char* fileName, char* cacheFile);
     int itemsInBundle(const char* nameOfBundle);
+    
+    // Once the budget is exceeded, unloads textures from the farthest rooms
+    // and then the least used ones until the low water mark is reached.
+    // Textures requested since the last flush and prefetched ones are pinned,
+    // so this is called once the new node has requested its textures.
     void flush();
+    void init();
+    
+    // Returns the contents of the given bundle, mapping it on the first
+    // request. The memory is read-only and valid until the manager is
+    // destroyed, so textures may upload straight from it. Anything other
+    // than a version 2 bundle is unmapped right away and returns NULL.
+    GLubyte* mapBundle(const char* fileName, long* size);
+    
+    // Loads the given textures in the background with the lowest priority,
+    // and reads ahead the given files so that they are served from the
+    // system cache later. Anything left from the previous call is cancelled.
+    void prefetch(std::vector<DGTexture*> &arrayOfTextures, std::vector<std::string> &arrayOfFiles);
+    
+    // Loads the given textures in the background ahead of prefetches and
+    // keeps them until the next switch, reading ahead the given files as
+    // well. Replaces what is left of the previous call.
+    void preload(std::vector<DGTexture*> &arrayOfTextures, std::vector<std::string> &arrayOfFiles);
+    
+    // From 0 to 1, counting textures that failed to load as done
+    float preloadProgress();
     void registerTexture(DGTexture* target);
     void requestBundle(DGNode* forNode);
+    
+    // Loads an image for the interface, packed with others in a shared page
+    // if it's small enough. Returns the texture to bind along with the
+    // coordinates of the image in it and its size.
+    DGTexture* requestImage(const char* fileName, float* arrayOfTexCoords, DGSize* size);
+    
+    // Returns immediately, the texture is ready once it's uploaded. If its
+    // bundle has small enough levels, they are drawn meanwhile.
     void requestTexture(DGTexture* target);
+    
+    // Textures seen in the given direction are loaded sooner the nearer
+    // they are to the view or the focus. Otherwise they go first.
+    void requestTexture(DGTexture* target, DGVector direction);
+    
+    // Called every frame for a node streamed in tiles. Returns the tiles
+    // in view, from the smallest level to the largest, and requests those
+    // that aren't loaded. Tiles that leave the view are evicted first.
+    void requestTiles(DGTileSet* tileSet, std::vector<DGTile*> &arrayOfTiles);
+    
+    // Performs pending uploads within the budget for a frame, so must be
+    // called once per frame from the main thread
+    void process();
+    
+    // Textures of nodes in rooms far from the current one are evicted
+    // first. The distance is the number of switches between both rooms.
+    void setDistance(DGNode* node, int distance);
+    
+    // Textures around this direction are loaded first, along with
+    // those in view. Set when the player clicks a switch.
+    void setFocus(DGVector direction);
+    void terminate();
+    
+    // Unpacks the payload of a bundle with compression level 2, which must
+    // fill the target exactly. Idle loaders help with the chunks, so this is
+    // best called from a loader as well. Returns false if any is damaged.
+    bool unpack(const GLubyte* payload, long size, GLubyte* target, long targetSize);
+    
+    // This method is called asynchronously by the loaders, and sleeps
+    // until something is queued if there's nothing to do
+    bool update();
 };
 
 #endif // DG_TEXTUREMANAGER_H